@@ -0,0 +1,331 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Daemon.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QLocalSocket>
+#include <QStandardPaths>
+#include <QSocketNotifier>
+#include <QtEndian>
+#include <iostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "future/AwaitTerminal.h"
+#include "future/FutureCombinators.h"
+#include "package/PackageDatabase.h"
+#include "CommandLineParser.h"
+#include "TermUtil.h"
+#include "Functional.h"
+#include "Exception.h"
+
+namespace Ralph {
+using namespace Common;
+using namespace ClientLib;
+
+namespace Client {
+
+// only commands that neither change anything nor ask the user for anything, without the leading program name
+static const QVector<QVector<QString>> s_servedCommands = {
+	{"package", "search"},
+	{"package", "check"},
+	{"sources", "list"},
+	{"sources", "show"},
+	{"info"},
+	// invoked by cmake on every configure, which is where the warm databases help the most
+	{"integration", "cmake", "cmake_path"},
+	{"integration", "cmake", "load"}
+};
+
+// written to by the signal handler, which can't do much more than that, and read by the event loop
+static int s_signalSockets[2] = {-1, -1};
+
+static void signalHandler(const int sig)
+{
+	const char byte = char(sig);
+	const ssize_t written = ::write(s_signalSockets[0], &byte, 1);
+	Q_UNUSED(written)
+	// a second one terminates immediately
+	std::signal(sig, SIG_DFL);
+}
+
+static bool isServed(const CommandLine::Parser &parser, const QStringList &arguments)
+{
+	try {
+		const CommandLine::Result result = parser.check(arguments);
+		// global options like --help, --trace or --jobs affect the whole process
+		for (const CommandLine::Option &option : parser.options()) {
+			if (result.isSet(option.names().first())) {
+				return false;
+			}
+		}
+		return s_servedCommands.contains(result.commandChain().mid(1));
+	} catch (Exception &) {
+		// invalid arguments, leave it to the normal invocation to show the help (which exits the process)
+		return false;
+	}
+}
+
+static QByteArray frame(const QByteArray &payload)
+{
+	QByteArray out;
+	QDataStream str(&out, QIODevice::WriteOnly);
+	str.setVersion(QDataStream::Qt_5_0);
+	str << payload;
+	return out;
+}
+/// Removes a complete frame from the front of buffer and returns it in payload, returns false if there is none yet
+static bool takeFrame(QByteArray &buffer, QByteArray *payload)
+{
+	if (buffer.size() < 4 || quint32(buffer.size()) - 4 < qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(buffer.constData()))) {
+		return false;
+	}
+	QDataStream str(buffer);
+	str.setVersion(QDataStream::Qt_5_0);
+	str >> *payload;
+	buffer.remove(0, payload->size() + 4);
+	return true;
+}
+
+Daemon::Daemon(const CommandLine::Parser &parser, const Handler &handler)
+	: m_parser(parser), m_handler(handler)
+{
+	QObject::connect(&m_server, &QLocalServer::newConnection, [this]()
+	{
+		while (QLocalSocket *socket = m_server.nextPendingConnection()) {
+			QObject::connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+			QObject::connect(socket, &QLocalSocket::readyRead, socket, [this, socket]() { handle(socket); });
+		}
+	});
+
+	// changes usually come in bursts, like a new index being written right after db.json
+	m_reloadTimer.setSingleShot(true);
+	m_reloadTimer.setInterval(200);
+	QObject::connect(&m_reloadTimer, &QTimer::timeout, [this]() { reloadChanged(); });
+	QObject::connect(&m_watcher, &QFileSystemWatcher::directoryChanged, [this](const QString &dir)
+	{
+		m_changedDirs.insert(dir);
+		m_reloadTimer.start();
+	});
+}
+Daemon::~Daemon()
+{
+	if (m_signalNotifier) {
+		sigaction(SIGINT, &m_previousSigint, nullptr);
+		sigaction(SIGTERM, &m_previousSigterm, nullptr);
+	}
+}
+
+int Daemon::exec()
+{
+	QLocalSocket existing;
+	existing.connectToServer(socketPath());
+	if (existing.waitForConnected(100)) {
+		throw Exception("A daemon is already running at %1" % socketPath());
+	}
+
+	PackageDatabase::setKeepLoaded(true);
+	// system and user databases are used by every request, so get them ready before accepting any
+	awaitTerminal(PackageDatabase::create(QString()));
+	awaitTerminal(whenAll(Functional::map(PackageDatabase::loadedDatabases(), [](PackageDatabase *db) { return db->build(); })));
+	watchDatabases();
+
+	handleSignals();
+	listen();
+	Term::out() << "Listening on " << socketPath() << std::endl;
+	return QCoreApplication::exec();
+}
+void Daemon::listen()
+{
+	// left behind by a daemon that did not exit cleanly
+	QLocalServer::removeServer(socketPath());
+	m_server.setSocketOptions(QLocalServer::UserAccessOption);
+	if (!m_server.listen(socketPath())) {
+		throw Exception("Unable to listen on %1: %2" % socketPath() % m_server.errorString());
+	}
+}
+
+void Daemon::handleSignals()
+{
+	if (s_signalSockets[0] == -1 && ::socketpair(AF_UNIX, SOCK_STREAM, 0, s_signalSockets) != 0) {
+		throw Exception("Unable to create the socket pair for signal handling");
+	}
+	if (m_signalNotifier) {
+		return;
+	}
+	m_signalNotifier = std::make_unique<QSocketNotifier>(s_signalSockets[1], QSocketNotifier::Read);
+	QObject::connect(m_signalNotifier.get(), &QSocketNotifier::activated, [this]()
+	{
+		char byte;
+		const ssize_t bytesRead = ::read(s_signalSockets[1], &byte, 1);
+		Q_UNUSED(bytesRead)
+		stop();
+	});
+
+	// replaces cancelAll() from main(), which would leave the daemon running but unable to do anything
+	struct sigaction action{};
+	action.sa_handler = &signalHandler;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGINT, &action, &m_previousSigint);
+	sigaction(SIGTERM, &action, &m_previousSigterm);
+}
+
+bool Daemon::forward(const CommandLine::Parser &parser, const QStringList &arguments, int *exitCode)
+{
+	if (qEnvironmentVariableIsSet("RALPH_NO_DAEMON") || !isServed(parser, arguments)) {
+		return false;
+	}
+	QLocalSocket socket;
+	socket.connectToServer(socketPath());
+	if (!socket.waitForConnected(100)) {
+		return false;
+	}
+
+	QByteArray request;
+	{
+		QDataStream str(&request, QIODevice::WriteOnly);
+		str.setVersion(QDataStream::Qt_5_0);
+		// the output is shown in our terminal, not in the one of the daemon
+		str << QCoreApplication::applicationVersion() << arguments << QDir::currentPath() << Term::isTty() << qint32(Term::currentWidth());
+	}
+	socket.write(frame(request));
+	socket.flush();
+
+	QByteArray buffer;
+	QByteArray response;
+	while (!takeFrame(buffer, &response)) {
+		if (socket.bytesAvailable() == 0 && !socket.waitForReadyRead(-1)) {
+			// the daemon went away, so we just do it ourselves
+			return false;
+		}
+		buffer += socket.readAll();
+	}
+
+	QDataStream str(response);
+	str.setVersion(QDataStream::Qt_5_0);
+	bool served = false;
+	qint32 code = 0;
+	QByteArray out;
+	QByteArray err;
+	str >> served >> code >> out >> err;
+	if (str.status() != QDataStream::Ok || !served) {
+		return false;
+	}
+	Term::out().write(out.constData(), out.size());
+	Term::err().write(err.constData(), err.size());
+	*exitCode = code;
+	return true;
+}
+
+QString Daemon::socketPath()
+{
+	const QString runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+	// without a directory QLocalServer picks a location itself
+	return runtimeDir.isEmpty() ? QStringLiteral("ralph-daemon") : QDir(runtimeDir).absoluteFilePath("ralph-daemon");
+}
+
+void Daemon::handle(QLocalSocket *socket)
+{
+	QByteArray buffer = socket->property("buffer").toByteArray() + socket->readAll();
+	QByteArray request;
+	if (!takeFrame(buffer, &request)) {
+		socket->setProperty("buffer", buffer);
+		return;
+	}
+
+	QDataStream in(request);
+	in.setVersion(QDataStream::Qt_5_0);
+	QString version;
+	QStringList arguments;
+	QString workingDirectory;
+	bool isTty = false;
+	qint32 width = 0;
+	in >> version >> arguments >> workingDirectory >> isTty >> width;
+
+	// a client of a different version might not even parse the same, so it should do it itself
+	const bool served = in.status() == QDataStream::Ok && version == QCoreApplication::applicationVersion() && isServed(m_parser, arguments);
+	qint32 exitCode = 0;
+	QByteArray out;
+	QByteArray err;
+	if (served) {
+		const QString previousDirectory = QDir::currentPath();
+		QDir::setCurrent(workingDirectory);
+		{
+			std::ostringstream outStream;
+			std::ostringstream errStream;
+			const Term::Output output(outStream, errStream, isTty, width);
+			const Term::Output::Scope scope(output);
+			try {
+				exitCode = m_handler(arguments);
+			} catch (std::exception &e) {
+				output.err() << e.what() << '\n';
+				exitCode = -1;
+			}
+			out = QByteArray::fromStdString(outStream.str());
+			err = QByteArray::fromStdString(errStream.str());
+		}
+		QDir::setCurrent(previousDirectory);
+		// the request might have loaded the database of a project
+		watchDatabases();
+	}
+
+	QByteArray response;
+	{
+		QDataStream str(&response, QIODevice::WriteOnly);
+		str.setVersion(QDataStream::Qt_5_0);
+		str << served << exitCode << out << err;
+	}
+	socket->write(frame(response));
+	socket->disconnectFromServer();
+}
+
+void Daemon::watchDatabases()
+{
+	// db.json and cache.dat are replaced rather than written to, so the directory is what we need to watch
+	for (const PackageDatabase *db : PackageDatabase::loadedDatabases()) {
+		if (!m_watcher.directories().contains(db->dir().absolutePath())) {
+			m_watcher.addPath(db->dir().absolutePath());
+		}
+	}
+}
+void Daemon::reloadChanged()
+{
+	// requests are handled on this thread as well, so no request is using a database while it is reloaded
+	for (PackageDatabase *db : PackageDatabase::loadedDatabases()) {
+		// we get notified of the index we write ourselves as well
+		if (m_changedDirs.contains(db->dir().absolutePath()) && db->isOutdated()) {
+			try {
+				db->reload().result();
+			} catch (std::exception &e) {
+				Term::err() << "Unable to reload " << db->dir().absolutePath() << ": " << e.what() << std::endl;
+			}
+		}
+	}
+	m_changedDirs.clear();
+}
+void Daemon::stop()
+{
+	// also removes the socket, so clients run their commands themselves again
+	m_server.close();
+	QCoreApplication::quit();
+}
+
+}
+}
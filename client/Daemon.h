@@ -0,0 +1,92 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QFileSystemWatcher>
+#include <QLocalServer>
+#include <QSet>
+#include <QTimer>
+#include <csignal>
+#include <functional>
+#include <memory>
+
+class QSocketNotifier;
+
+class QLocalSocket;
+
+namespace Ralph {
+namespace Common {
+namespace CommandLine {
+class Parser;
+}
+}
+namespace ClientLib {
+class PackageDatabase;
+}
+
+namespace Client {
+
+/**
+ * Keeps the package databases loaded between invocations of ralph, see `ralph daemon`.
+ *
+ * Commands that neither change anything nor need any input are run inside the daemon, just
+ * like a normal invocation would run them but with the output collected (see Term::Output) and
+ * sent back. Loaded databases are reloaded whenever another process changes them, for example
+ * by adding or updating a source.
+ *
+ * Requests and responses are a QByteArray in a QDataStream, request: version, arguments,
+ * working directory, whether stdout is a terminal and its width, response: whether it was
+ * served, exit code, stdout and stderr.
+ */
+class Daemon
+{
+public:
+	using Handler = std::function<int(const QStringList &arguments)>;
+
+	explicit Daemon(const Common::CommandLine::Parser &parser, const Handler &handler);
+	~Daemon();
+
+	/// Loads the system and user databases and serves requests until the process is terminated
+	int exec();
+	/// Starts accepting requests, which are served once the event loop runs. exec() does this after loading the databases.
+	void listen();
+	/// Makes SIGINT and SIGTERM stop accepting requests and quit the event loop, instead of canceling everything. exec() does this as well.
+	void handleSignals();
+
+	/// Runs arguments in a running daemon instead of this process, returns false if there is none or it can't serve them
+	static bool forward(const Common::CommandLine::Parser &parser, const QStringList &arguments, int *exitCode);
+
+	static QString socketPath();
+
+private:
+	const Common::CommandLine::Parser &m_parser;
+	const Handler m_handler;
+	QLocalServer m_server;
+	QFileSystemWatcher m_watcher;
+	QTimer m_reloadTimer;
+	QSet<QString> m_changedDirs;
+	std::unique_ptr<QSocketNotifier> m_signalNotifier;
+	struct sigaction m_previousSigint;
+	struct sigaction m_previousSigterm;
+
+	void handle(QLocalSocket *socket);
+	void watchDatabases();
+	void reloadChanged();
+	void stop();
+};
+
+}
+}
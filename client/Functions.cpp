@@ -17,13 +17,22 @@
 
 #include <QFutureWatcher>
 #include <QException>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
 #include <QStandardPaths>
 
+#include <functional>
 #include <iostream>
 
 #include "future/AwaitTerminal.h"
+#include "future/FutureCombinators.h"
 #include "project/ProjectGenerator.h"
 #include "project/Project.h"
+#include "project/ProjectLockFile.h"
+#include "package/DependencyResolver.h"
+#include "package/PackageInstaller.h"
 #include "package/PackageSource.h"
 #include "package/PackageGroup.h"
 #include "task/Network.h"
@@ -75,11 +84,9 @@ const Package *queryPackage(const PackageDatabase *db, const QString &query)
 	const QString name = query.mid(0, splitIndex);
 	const VersionRequirement version = splitIndex == -1 ? VersionRequirement() : VersionRequirement::fromString(query.mid(splitIndex + 1));
 
-	QVector<const Package *> candidates = db->findPackages(name, version);
-	std::sort(candidates.begin(), candidates.end(), [](const Package *a, const Package *b) { return a->version() < b->version(); });
-
-	if (candidates.isEmpty()) {
-		const bool haveOtherVersions = !db->findPackages(name).isEmpty();
+	const Package *pkg = db->bestPackage(name, version);
+	if (!pkg) {
+		const bool haveOtherVersions = db->bestPackage(name) != nullptr;
 		if (haveOtherVersions) {
 			throw Exception("No package found for %1, but other versions are available" % query);
 		} else {
@@ -87,7 +94,17 @@ const Package *queryPackage(const PackageDatabase *db, const QString &query)
 		}
 	}
 
-	return candidates.first();
+	return pkg;
+}
+
+void installResolution(PackageDatabase *db, const QString &group, const PackageConfiguration &config, const DependencyResolver::Resolution &resolution)
+{
+	PackageInstaller installer(db->group(group), config);
+	const Future<void> all = installer.install(resolution);
+	awaitTerminal(all, Functional::map(resolution.packages, [&installer](const Package *pkg)
+	{
+		return qMakePair("%1 %2" % pkg->name() % pkg->version().toString(), installer.package(pkg));
+	}));
 }
 }
 
@@ -98,10 +115,10 @@ State::State()
 	{
 		if (query.allowedTypes() & Git::GitCredentialQuery::UsernamePassword) {
 			std::string username;
-			std::cout << "Username and password for %1 required:\n" % query.url().toString()
+			Term::out() << "Username and password for %1 required:\n" % query.url().toString()
 					  << "Username [%1]: " % query.usernameFromUrl();
 			std::getline(std::cin, username);
-			std::cout << "Password []: ";
+			Term::out() << "Password []: ";
 			const QString password = Term::readPassword();
 			return Git::GitCredentialResponse::createForUsernamePassword(
 						username.empty() ? query.usernameFromUrl() : QString::fromStdString(username),
@@ -115,6 +132,7 @@ State::State()
 void State::removePackage(const CommandLine::Result &result)
 {
 	PackageDatabase *db = awaitTerminal(createDB());
+	const PackageDatabase::Pin pin = db->pin();
 	const QString group = result.value("group");
 
 	Functional::collection(result.argumentMulti("packages"))
@@ -124,17 +142,45 @@ void State::removePackage(const CommandLine::Result &result)
 void State::installPackage(const CommandLine::Result &result)
 {
 	PackageDatabase *db = awaitTerminal(createDB());
+	const PackageDatabase::Pin pin = db->pin();
 	const QString group = result.value("group");
 
 	const PackageConfiguration config = PackageConfiguration::fromItems(result.values("config"));
 
-	Functional::collection(result.argumentMulti("packages"))
-			.map([db](const QString &query) { return queryPackage(db, query); })
-			.each([db, group, config](const Package *pkg) { awaitTerminal(db->group(group).install(pkg, config)); });
+	// only what was asked for is installed, but if some of it depends on others of it those have to go first
+	const QVector<const Package *> packages = Functional::map(result.argumentMulti("packages"), [db](const QString &query) { return queryPackage(db, query); });
+	DependencyResolver::Resolution resolution;
+	for (const Package *pkg : packages) {
+		for (const PackageDependency &dep : pkg->dependencies()) {
+			for (const Package *other : packages) {
+				if (!dep.isOptional() && dep.package().compare(other->name(), Qt::CaseInsensitive) == 0) {
+					resolution.dependencies[pkg].append(other);
+				}
+			}
+		}
+	}
+	QSet<const Package *> visited;
+	std::function<void(const Package *)> visit = [&resolution, &visited, &visit](const Package *pkg)
+	{
+		visited.insert(pkg);
+		for (const Package *dependency : resolution.dependencies.value(pkg)) {
+			if (!visited.contains(dependency)) {
+				visit(dependency);
+			}
+		}
+		resolution.packages.append(pkg);
+	};
+	for (const Package *pkg : packages) {
+		if (!visited.contains(pkg)) {
+			visit(pkg);
+		}
+	}
+	installResolution(db, group, config, resolution);
 }
 void State::checkPackage(const CommandLine::Result &result)
 {
 	PackageDatabase *db = awaitTerminal(createDB());
+	const PackageDatabase::Pin pin = db->pin();
 	const QString group = result.value("group");
 
 	Functional::collection(result.argumentMulti("packages"))
@@ -143,11 +189,26 @@ void State::checkPackage(const CommandLine::Result &result)
 }
 void State::searchPackages(const CommandLine::Result &result)
 {
-	const QRegExp query{result.argument("query"), Qt::CaseInsensitive, QRegExp::WildcardUnix};
+	const QString query = result.argument("query");
+	const int limit = int(result.value<unsigned int>("limit"));
 	PackageDatabase *db = awaitTerminal(createDB());
-	Functional::collection(db->packageNames())
-			.filter([query](const QString &str) { return query.isEmpty() || str.contains(query); })
-			.each([query](const QString &str) { std::cout << str << '\n'; });
+
+	// wildcards are still supported, but can't use the index
+	if (query.contains(QRegExp("[*?\\[]"))) {
+		const QRegExp wildcard{query, Qt::CaseInsensitive, QRegExp::WildcardUnix};
+		QVector<QString> names = Functional::filter(db->packageNames(), [wildcard](const QString &str) { return str.contains(wildcard); });
+		if (limit > 0 && names.size() > limit) {
+			names.resize(limit);
+		}
+		for (const QString &name : names) {
+			Term::out() << name << '\n';
+		}
+		return;
+	}
+
+	for (const NameSearch::Match &match : db->search(query, limit)) {
+		Term::out() << match.name << '\n';
+	}
 }
 
 void State::setDir(const QString &dir)
@@ -158,7 +219,7 @@ void State::setDir(const QString &dir)
 void State::verifyProject()
 {
 	const Project *project = Project::load(m_dir);
-	std::cout << "The project " << Common::Term::style(Common::Term::Bold, project->name()) << " in " << m_dir << " is valid!\n";
+	Term::out() << "The project " << Common::Term::style(Common::Term::Bold, project->name()) << " in " << m_dir << " is valid!\n";
 }
 void State::newProject(const CommandLine::Result &result)
 {
@@ -168,17 +229,42 @@ void State::newProject(const CommandLine::Result &result)
 	generator.setVCS(result.value("version-control-system"));
 	generator.setDirectory(m_dir);
 	Project *project = awaitTerminal(generator.generate());
-	std::cout << "The project " << project->name().toLocal8Bit().constData() << " was created successfully!\n";
+	Term::out() << "The project " << project->name().toLocal8Bit().constData() << " was created successfully!\n";
 }
 void State::installProject(const CommandLine::Result &result)
 {
-	Q_UNUSED(result)
-	// TODO project install
+	// everything that is locked stays as it is, unless it no longer fits ralph.json
+	resolveProject(result, {}, false);
 }
 void State::updateProject(const CommandLine::Result &result)
 {
-	Q_UNUSED(result)
-	// TODO project update
+	const bool all = !result.hasArgument("packages");
+	resolveProject(result, all ? QVector<QString>() : result.argumentMulti("packages"), all);
+}
+void State::resolveProject(const CommandLine::Result &result, const QVector<QString> &update, const bool updateAll)
+{
+	const Project *project = Project::load(m_dir);
+	PackageDatabase *db = awaitTerminal(result.isSet("in-project") ? createDB() : PackageDatabase::create(QString()));
+	// the resolution refers to the packages until everything is installed
+	const PackageDatabase::Pin pin = db->pin();
+	const QString group = result.value("group");
+	const PackageConfiguration config = PackageConfiguration::fromItems(result.values("config"));
+
+	ProjectLockFile lockfile(project);
+	QHash<QString, Version> preferred = updateAll ? QHash<QString, Version>() : lockfile.versions();
+	for (const QString &name : update) {
+		preferred.remove(name.toLower());
+	}
+
+	DependencyResolver resolver(db);
+	resolver.setPreferred(preferred);
+	const DependencyResolver::Resolution resolution = resolver.resolve(project);
+
+	installResolution(db, group, config, resolution);
+
+	// only once everything is installed, otherwise the next run would take it for granted
+	const PackageGroup target = db->group(group);
+	lockfile.setPackages(resolution.packages, &target);
 }
 
 void State::updateSources(const CommandLine::Result &result)
@@ -195,7 +281,7 @@ void State::updateSources(const CommandLine::Result &result)
 			  : db->sources();
 
 	for (PackageSource *source : sources) {
-		std::cout << "Updating " << source->typeString() << " source " << fg(Cyan, source->name()) << "...\n";
+		Term::out() << "Updating " << source->typeString() << " source " << fg(Cyan, source->name()) << "...\n";
 		awaitTerminal(source->update());
 	}
 }
@@ -210,7 +296,7 @@ void State::addSource(const CommandLine::Result &result)
 	source->setName(result.argument("name"));
 	source->setLastUpdated();
 	awaitTerminal(db->registerPackageSource(source));
-	std::cout << "New source " << source->name() << " successfully registered. You may want to run 'ralph sources update %1' now.\n" % source->name();
+	Term::out() << "New source " << source->name() << " successfully registered. You may want to run 'ralph sources update %1' now.\n" % source->name();
 }
 void State::removeSource(const CommandLine::Result &result)
 {
@@ -220,7 +306,7 @@ void State::removeSource(const CommandLine::Result &result)
 	}
 
 	awaitTerminal(db->unregisterPackageSource(result.argument("name")));
-	std::cout << "Source " << result.argument("name") << " was successfully removed.\n";
+	Term::out() << "Source " << result.argument("name") << " was successfully removed.\n";
 }
 void State::listSources(const CommandLine::Result &result)
 {
@@ -237,25 +323,25 @@ void State::listSources(const CommandLine::Result &result)
 			}
 		}
 
-		std::cout << style(Bold, "Package sources in the %1 database:\n" % databaseType);
+		Term::out() << style(Bold, "Package sources in the %1 database:\n" % databaseType);
 		for (const PackageSource *source : db->sources()) {
-			std::cout << " * " << source->name() << " (type: %1, last updated: %2)\n" % source->typeString() % fg(lastUpdatedColor(source), source->lastUpdated().toString());
+			Term::out() << " * " << source->name() << " (type: %1, last updated: %2)\n" % source->typeString() % fg(lastUpdatedColor(source), source->lastUpdated().toString());
 		}
 		if (db->sources().isEmpty()) {
-			std::cout << "    Empty.\n    Use 'ralph sources add <name> <url>' to add a source!\n";
+			Term::out() << "    Empty.\n    Use 'ralph sources add <name> <url>' to add a source!\n";
 		}
 	};
 
 	output(result.value("database"), true);
 
 	if (result.value("database") == "project") {
-		std::cout << '\n';
+		Term::out() << '\n';
 		output("user");
-		std::cout << '\n';
+		Term::out() << '\n';
 		output("system");
 	}
 	if (result.value("database") == "user") {
-		std::cout << '\n';
+		Term::out() << '\n';
 		output("system");
 	}
 }
@@ -265,21 +351,102 @@ void State::showSource(const CommandLine::Result &result)
 
 	PackageDatabase *db = awaitTerminal(createDatabase(result.value("database")));
 	PackageSource *src = db->source(result.argument("name"));
-	std::cout << style(Bold, "Name: ") << src->name() << '\n'
+	Term::out() << style(Bold, "Name: ") << src->name() << '\n'
 			  << style(Bold, "Last updated: ") << fg(lastUpdatedColor(src), src->lastUpdated().toString()) << '\n'
 			  << style(Bold, "Type: ") << src->typeString() << '\n';
 }
 
+void State::reindexDatabase(const CommandLine::Result &result)
+{
+	PackageDatabase *db = awaitTerminal(createDatabase(result.value("database")));
+	if (!db) {
+		throw Exception("Database does not exists and unable to create it");
+	}
+
+	awaitTerminal(db->build());
+	Term::out() << "The " << result.value("database") << " database is indexed and ready.\n";
+}
+
+void State::databaseStats(const CommandLine::Result &result)
+{
+	using namespace Term;
+	const bool json = result.isSet("json");
+
+	// status messages would end up in the JSON, so only show them for humans
+	const QString projectDir = QDir(m_dir).exists("vendor") ? QDir(m_dir).absoluteFilePath("vendor") : QString();
+	Future<PackageDatabase *> created = PackageDatabase::create(projectDir);
+	PackageDatabase *db = json ? await(created) : awaitTerminal(created);
+	QVector<PackageDatabase *> layers;
+	for (; db; db = db->inheritedDatabases().isEmpty() ? nullptr : db->inheritedDatabases().first()) {
+		layers.append(db);
+	}
+
+	// measures a cold start, unless the index is already built in this process (like in the daemon)
+	const Future<void> built = whenAll(Functional::map(layers, [](PackageDatabase *layer) { return layer->build(); }));
+	if (json) {
+		await(built);
+	} else {
+		awaitTerminal(built);
+	}
+
+	auto layerName = [](const PackageDatabase *layer) -> QString
+	{
+		for (const QString &type : {QStringLiteral("system"), QStringLiteral("user")}) {
+			if (layer->dir() == QDir(PackageDatabase::databasePath(type))) {
+				return type;
+			}
+		}
+		return "project";
+	};
+
+	QJsonArray out;
+	for (const PackageDatabase *layer : layers) {
+		const PackageDatabase::Stats stats = layer->stats();
+		if (json) {
+			out.append(QJsonObject({
+									   qMakePair(QStringLiteral("layer"), QJsonValue(layerName(layer))),
+									   qMakePair(QStringLiteral("path"), QJsonValue(layer->dir().absolutePath())),
+									   qMakePair(QStringLiteral("sources"), QJsonValue(stats.sources)),
+									   qMakePair(QStringLiteral("manifests"), QJsonValue(stats.manifests)),
+									   qMakePair(QStringLiteral("bytesParsed"), QJsonValue(stats.bytesParsed)),
+									   qMakePair(QStringLiteral("loadTimeUs"), QJsonValue(stats.loadTime)),
+									   qMakePair(QStringLiteral("buildTimeUs"), QJsonValue(stats.buildTime)),
+									   qMakePair(QStringLiteral("jsonParseTimeUs"), QJsonValue(stats.parseTime)),
+									   qMakePair(QStringLiteral("fromJsonTimeUs"), QJsonValue(stats.fromJsonTime)),
+									   qMakePair(QStringLiteral("cacheHit"), QJsonValue(stats.cacheHit)),
+									   qMakePair(QStringLiteral("indexBytes"), QJsonValue(stats.indexSize)),
+									   qMakePair(QStringLiteral("indexResidentBytes"), QJsonValue(stats.indexResident))
+								   }));
+			continue;
+		}
+
+		auto ms = [](const qint64 us) { return QString::number(double(us) / 1000.0, 'f', 1) + " ms"; };
+		Term::out() << style(Bold, "The %1 database at %2:\n" % layerName(layer) % layer->dir().absolutePath())
+				  << "    Sources: " << stats.sources << '\n'
+				  << "    Manifests: " << stats.manifests << '\n'
+				  << "    Parsed: " << stats.bytesParsed << " bytes\n"
+				  << "    load(): " << ms(stats.loadTime) << '\n'
+				  << "    build(): " << ms(stats.buildTime) << '\n'
+				  << "      JSON parsing: " << ms(stats.parseTime) << '\n'
+				  << "      Package::fromJson: " << ms(stats.fromJsonTime) << '\n'
+				  << "    cache.dat: " << (stats.cacheHit ? fg(Green, "hit") : fg(Yellow, "miss")) << '\n'
+				  << "    Index: " << stats.indexResident << " of " << stats.indexSize << " bytes resident\n";
+	}
+	if (json) {
+		Term::out() << QJsonDocument(out).toJson().constData();
+	}
+}
+
 void State::info()
 {
 	const QString systemPath = PackageDatabase::databasePath("system");
 	if (!systemPath.isEmpty()) {
-		std::cout << "Available database location: system at " << systemPath << '\n';
+		Term::out() << "Available database location: system at " << systemPath << '\n';
 	}
 
 	const QString userPath = PackageDatabase::databasePath("user");
 	if (!userPath.isEmpty()) {
-		std::cout << "Available database location: user at " << userPath << '\n';
+		Term::out() << "Available database location: user at " << userPath << '\n';
 	}
 }
 
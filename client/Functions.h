@@ -53,10 +53,15 @@ public:
 	void listSources(const Common::CommandLine::Result &result);
 	void showSource(const Common::CommandLine::Result &result);
 
+	void reindexDatabase(const Common::CommandLine::Result &result);
+	void databaseStats(const Common::CommandLine::Result &result);
+
 	void info();
 
 protected:
 	Future<PackageDatabase *> createDB();
+	/// Resolves ralph.json, locks the result and installs it
+	void resolveProject(const Common::CommandLine::Result &result, const QVector<QString> &update, const bool updateAll);
 
 	QString m_dir;
 };
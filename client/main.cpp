@@ -19,11 +19,16 @@
 #include <QDebug>
 #include <QResource>
 #include <iostream>
+#include <csignal>
 
 #include "Functions.h"
 #include "Functional.h"
 #include "CMakeIntegration.h"
+#include "Daemon.h"
 #include "CommandLineParser.h"
+#include "task/Executor.h"
+#include "task/Trace.h"
+#include "future/Future.h"
 #include "config.h"
 
 int main(int argc, char **argv) {
@@ -34,6 +39,13 @@ int main(int argc, char **argv) {
 
 	Q_INIT_RESOURCE(resources);
 
+	// first Ctrl-C cancels all running tasks, a second one terminates immediately
+	std::signal(SIGINT, [](int)
+	{
+		Ralph::ClientLib::cancelAll();
+		std::signal(SIGINT, SIG_DFL);
+	});
+
 	using namespace Ralph::Common::CommandLine;
 	using Ralph::Client::State;
 
@@ -46,6 +58,14 @@ int main(int argc, char **argv) {
 			.addHelpOption()
 			.addVersionCommand()
 			.addVersionOption()
+			.add(Option({"jobs", "j"}, "N")
+				 .setArgumentRequired(true)
+				 .setDescription("Number of threads to run tasks on. Defaults to the number of cores.")
+				 .then([](const Result &result) { Ralph::ClientLib::Executor::setDefaultThreadCount(result.value<unsigned int>("jobs")); }))
+			.add(Option({"trace"}, "FILE")
+				 .setArgumentRequired(true)
+				 .setDescription("Write a trace of all tasks to FILE, for viewing in chrome://tracing")
+				 .then([](const Result &result) { Ralph::ClientLib::Trace::enable(result.value("trace")); }))
 			.add(Command("package", "Low-level commands for package management")
 				 .add(Command("install", "Install the specified packages")
 					  .add(PositionalArgument("packages", "The packages to install").setMulti(true))
@@ -70,6 +90,9 @@ int main(int argc, char **argv) {
 					  .then(state, &State::checkPackage))
 				 .add(Command("search", "Searches for a package")
 					  .add(PositionalArgument("query", "Filter packages by this query."))
+					  .add(Option({"limit", "n"}, "N")
+						   .setDescription("Show at most N results, all if 0")
+						   .setArgumentRequired(true).setDefaultValue("0"))
 					  .then(state, &State::searchPackages)))
 			.add(Command("project", "High-level commands for package management")
 				 .add(Option({"directory", "d"}, "DIR")
@@ -131,6 +154,17 @@ int main(int argc, char **argv) {
 					  .setArgumentRequired(true)
 					  .setDefaultValue("user").setAllowedValues({"system", "user"})
 					  .setDescription("Which database to use")))
+			.add(Command("db", "Manage the package databases")
+				 .add(Command("reindex", "Builds the package index now, instead of on first use")
+					  .add(Option({"database", "db"}, "DATABASE")
+						   .setArgumentRequired(true)
+						   .setDefaultValue("user").setAllowedValues({"system", "user"})
+						   .setDescription("Which database to use"))
+					  .then(state, &State::reindexDatabase))
+				 .add(Command("stats", "Shows where loading each database layer spends its time")
+					  .add(Option("json")
+						   .setDescription("Print the statistics as JSON"))
+					  .then(state, &State::databaseStats)))
 			.add(Command("integration", "Helpers for various integrations")
 				 .setHidden()
 				 .add(Command("cmake", "Helpers for CMake integration")
@@ -143,6 +177,17 @@ int main(int argc, char **argv) {
 						   .then(&Ralph::Integration::CMake::cmakeLoad))))
 			.add(Command("info", "Shows various debugging information about Ralph")
 				 .then(state, &State::info))
+			.add(Command("daemon", "Keeps the package databases loaded and serves other invocations of ralph from them")
+				 .then([&cli, &state]()
+	{
+		Ralph::Client::Daemon daemon(cli, [&cli, &state](const QStringList &arguments)
+		{
+			// every request starts from scratch, like a separate invocation would
+			state.setDir(QString());
+			return cli.process(arguments);
+		});
+		daemon.exec();
+	}))
 			.addCommandAlias("install", "package install")
 			.addCommandAlias("remove", "package remove")
 			.addCommandAlias("check", "package check")
@@ -151,5 +196,10 @@ int main(int argc, char **argv) {
 			.addCommandAlias("new", "project new")
 			.addCommandAlias("update", "sources update");
 
-	return cli.process(app);
+	int ret = 0;
+	if (!Ralph::Client::Daemon::forward(cli, app.arguments(), &ret)) {
+		ret = cli.process(app);
+	}
+	Ralph::ClientLib::Trace::write();
+	return ret;
 }
@@ -0,0 +1,289 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QLocalSocket>
+#include <chrono>
+#include <csignal>
+#include <future>
+#include <iostream>
+#include <sstream>
+
+#include "Daemon.h"
+#include "CommandLineParser.h"
+#include "TermUtil.h"
+#include "Exception.h"
+
+using namespace Ralph::Client;
+using namespace Ralph::Common;
+
+struct Forwarded
+{
+	bool forwarded;
+	int exitCode;
+	std::string out;
+	std::string err;
+};
+
+class Daemon_Test : public QObject
+{
+	Q_OBJECT
+public:
+	virtual ~Daemon_Test();
+
+private:
+	QTemporaryDir m_runtimeDir;
+	CommandLine::Parser m_parser;
+
+	// what the handler saw during the last request
+	QStringList m_arguments;
+	QString m_workingDirectory;
+	QString m_resolvedLast;
+	bool m_isTty = false;
+	int m_width = 0;
+
+	Daemon::Handler recordingHandler(const int exitCode)
+	{
+		m_arguments.clear();
+		return [this, exitCode](const QStringList &arguments)
+		{
+			m_arguments = arguments;
+			m_workingDirectory = QDir::currentPath();
+			m_resolvedLast = QDir(arguments.last()).absolutePath();
+			m_isTty = Term::isTty();
+			m_width = Term::currentWidth();
+			Term::out() << "found " << arguments.last() << '\n';
+			Term::err() << "slow mirror\n";
+			return exitCode;
+		};
+	}
+
+	/// Forwards from another thread, the daemon is served by the event loop of this one
+	Forwarded forward(const QStringList &arguments, const bool isTty = false, const int width = 80)
+	{
+		std::future<Forwarded> future = std::async(std::launch::async, [this, arguments, isTty, width]()
+		{
+			std::ostringstream out;
+			std::ostringstream err;
+			const Term::Output output(out, err, isTty, width);
+			const Term::Output::Scope scope(output);
+			Forwarded result{false, 0, {}, {}};
+			result.forwarded = Daemon::forward(m_parser, arguments, &result.exitCode);
+			result.out = out.str();
+			result.err = err.str();
+			return result;
+		});
+		while (future.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+			QCoreApplication::processEvents();
+		}
+		return future.get();
+	}
+	/// Sends a request the way forward() does, but with any version and working directory, returns the response
+	QByteArray request(const QString &version, const QStringList &arguments, const QString &workingDirectory)
+	{
+		std::future<QByteArray> future = std::async(std::launch::async, [version, arguments, workingDirectory]()
+		{
+			QByteArray payload;
+			{
+				QDataStream str(&payload, QIODevice::WriteOnly);
+				str.setVersion(QDataStream::Qt_5_0);
+				str << version << arguments << workingDirectory << false << qint32(80);
+			}
+			QByteArray frame;
+			{
+				QDataStream str(&frame, QIODevice::WriteOnly);
+				str.setVersion(QDataStream::Qt_5_0);
+				str << payload;
+			}
+
+			QLocalSocket socket;
+			socket.connectToServer(Daemon::socketPath());
+			if (!socket.waitForConnected(1000)) {
+				return QByteArray();
+			}
+			socket.write(frame);
+			socket.flush();
+			QByteArray buffer;
+			while (socket.waitForReadyRead(1000)) {
+				buffer += socket.readAll();
+			}
+			buffer += socket.readAll();
+
+			QDataStream str(buffer);
+			str.setVersion(QDataStream::Qt_5_0);
+			QByteArray response;
+			str >> response;
+			return response;
+		});
+		while (future.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+			QCoreApplication::processEvents();
+		}
+		return future.get();
+	}
+
+private slots:
+	void initTestCase()
+	{
+		QVERIFY(m_runtimeDir.isValid());
+		qputenv("XDG_RUNTIME_DIR", m_runtimeDir.path().toLocal8Bit());
+		m_parser
+				.add(CommandLine::Option({"trace"}, "FILE").setArgumentRequired(true))
+				.add(CommandLine::Command("package")
+					 .add(CommandLine::Command("search")
+						  .add(CommandLine::PositionalArgument("query", "")))
+					 .add(CommandLine::Command("install")
+						  .add(CommandLine::PositionalArgument("packages", "").setMulti(true))))
+				.add(CommandLine::Command("integration")
+					 .add(CommandLine::Command("cmake")
+						  .add(CommandLine::Command("cmake_path"))));
+	}
+
+	void servedCommandsRunInTheDaemon()
+	{
+		Daemon daemon(m_parser, recordingHandler(3));
+		daemon.listen();
+
+		const Forwarded result = forward({"ralph", "package", "search", "qt"}, true, 77);
+		QVERIFY(result.forwarded);
+		QCOMPARE(result.exitCode, 3);
+		QCOMPARE(QString::fromStdString(result.out), QString("found qt\n"));
+		QCOMPARE(QString::fromStdString(result.err), QString("slow mirror\n"));
+		QCOMPARE(m_arguments, QStringList({"ralph", "package", "search", "qt"}));
+		QCOMPARE(m_workingDirectory, QDir::currentPath());
+		// the terminal of the client, not the one of the daemon
+		QCOMPARE(m_isTty, true);
+		QCOMPARE(m_width, 77);
+
+		QVERIFY(forward({"ralph", "package", "search", "boost"}, false, 42).forwarded);
+		QCOMPARE(m_isTty, false);
+		QCOMPARE(m_width, 42);
+
+		// nothing of the requests ended up in the output of the daemon itself
+		QCOMPARE(&Term::out(), &std::cout);
+		QCOMPARE(&Term::err(), &std::cerr);
+	}
+	void cmakeIntegrationIsServed()
+	{
+		Daemon daemon(m_parser, recordingHandler(0));
+		daemon.listen();
+
+		QVERIFY(forward({"ralph", "integration", "cmake", "cmake_path"}).forwarded);
+		QCOMPARE(m_arguments, QStringList({"ralph", "integration", "cmake", "cmake_path"}));
+
+		// cmake passes the build directory relative to where it runs, which is not where the daemon runs
+		QTemporaryDir clientDir;
+		QVERIFY(clientDir.isValid());
+		const QString daemonDir = QDir::currentPath();
+		const QByteArray response = request(QCoreApplication::applicationVersion(),
+											{"ralph", "integration", "cmake", "load", "-c", "os:linux", "build"}, clientDir.path());
+		QDataStream str(response);
+		str.setVersion(QDataStream::Qt_5_0);
+		bool served = false;
+		str >> served;
+		QVERIFY(served);
+		QCOMPARE(m_workingDirectory, QDir(clientDir.path()).canonicalPath());
+		QCOMPARE(m_resolvedLast, QDir(clientDir.path()).canonicalPath() + "/build");
+		QCOMPARE(QDir::currentPath(), daemonDir);
+	}
+	void exceptionsAreReported()
+	{
+		Daemon daemon(m_parser, [](const QStringList &) -> int { throw Exception("No source with that name found"); });
+		daemon.listen();
+
+		const Forwarded result = forward({"ralph", "package", "search", "qt"});
+		QVERIFY(result.forwarded);
+		QCOMPARE(result.exitCode, -1);
+		QVERIFY2(QString::fromStdString(result.err).contains("No source with that name found"), result.err.c_str());
+	}
+
+	void signalsStopTheDaemon_data()
+	{
+		QTest::addColumn<int>("signum");
+		QTest::newRow("SIGINT") << SIGINT;
+		QTest::newRow("SIGTERM") << SIGTERM;
+	}
+	void signalsStopTheDaemon()
+	{
+		QFETCH(int, signum);
+		Daemon daemon(m_parser, recordingHandler(0));
+		daemon.handleSignals();
+		daemon.listen();
+		QVERIFY(forward({"ralph", "package", "search", "qt"}).forwarded);
+
+		std::raise(signum);
+		// the signal is handled by the event loop, forward() runs it while waiting
+		QTRY_VERIFY(!forward({"ralph", "package", "search", "qt"}).forwarded);
+		QVERIFY(!QFile::exists(Daemon::socketPath()));
+	}
+
+	void fallsBackWithoutDaemon()
+	{
+		const Forwarded result = forward({"ralph", "package", "search", "qt"});
+		QVERIFY(!result.forwarded);
+		QVERIFY(result.out.empty());
+	}
+	void fallsBackIfDisabled()
+	{
+		Daemon daemon(m_parser, recordingHandler(0));
+		daemon.listen();
+
+		qputenv("RALPH_NO_DAEMON", "1");
+		const Forwarded result = forward({"ralph", "package", "search", "qt"});
+		qunsetenv("RALPH_NO_DAEMON");
+		QVERIFY(!result.forwarded);
+		QVERIFY(m_arguments.isEmpty());
+	}
+	void fallsBackForCommandsItDoesNotServe_data()
+	{
+		QTest::addColumn<QStringList>("arguments");
+		QTest::newRow("changes something") << QStringList({"ralph", "package", "install", "qt"});
+		QTest::newRow("global option") << QStringList({"ralph", "--trace", "trace.json", "package", "search", "qt"});
+		QTest::newRow("invalid") << QStringList({"ralph", "package", "search"});
+	}
+	void fallsBackForCommandsItDoesNotServe()
+	{
+		QFETCH(QStringList, arguments);
+		Daemon daemon(m_parser, recordingHandler(0));
+		daemon.listen();
+
+		QVERIFY(!forward(arguments).forwarded);
+		QVERIFY(m_arguments.isEmpty());
+	}
+	void otherVersionsAreNotServed()
+	{
+		Daemon daemon(m_parser, recordingHandler(0));
+		daemon.listen();
+
+		const QByteArray response = request("0.0.1-other", {"ralph", "package", "search", "qt"}, QDir::currentPath());
+		QVERIFY(!response.isEmpty());
+		QDataStream str(response);
+		str.setVersion(QDataStream::Qt_5_0);
+		bool served = true;
+		qint32 exitCode = 0;
+		str >> served >> exitCode;
+		QCOMPARE(str.status(), QDataStream::Ok);
+		QVERIFY(!served);
+		QVERIFY(m_arguments.isEmpty());
+	}
+};
+Daemon_Test::~Daemon_Test() {}
+
+QTEST_GUILESS_MAIN(Daemon_Test)
+
+#include "Daemon_Test.moc"
@@ -15,6 +15,8 @@
 
 #include "Requirement.h"
 
+#include <QDataStream>
+
 #include "Json.h"
 #include "Functional.h"
 #include "ActionContext.h"
@@ -54,6 +56,40 @@ QJsonArray Requirement::toJson(const QVector<Ptr> &requirements)
 	return array;
 }
 
+Requirement::Ptr Requirement::read(QDataStream &stream)
+{
+	quint8 kind;
+	stream >> kind;
+	switch (Kind(kind)) {
+	case Kind::And:
+	case Kind::Or: {
+		quint32 count;
+		stream >> count;
+		QVector<Requirement::Ptr> children;
+		for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+			children.append(read(stream));
+		}
+		if (Kind(kind) == Kind::And) {
+			return std::make_shared<AndRequirement>(std::move(children));
+		} else {
+			return std::make_shared<OrRequirement>(std::move(children));
+		}
+	}
+	case Kind::Os: {
+		quint8 os;
+		stream >> os;
+		return std::make_shared<OsRequirement>(OsRequirement::Os(os));
+	}
+	case Kind::BuildType: {
+		QString configuration;
+		stream >> configuration;
+		return std::make_shared<BuildTypeRequirement>(configuration);
+	}
+	}
+	stream.setStatus(QDataStream::ReadCorruptData);
+	return nullptr;
+}
+
 const OsRequirement::Os OsRequirement::m_currentOs =
 		#if defined(Q_OS_LINUX)
 		OsRequirement::Linux
@@ -77,6 +113,10 @@ QJsonObject OsRequirement::toJson() const
 	}
 	return QJsonObject({qMakePair(QStringLiteral("os"), value)});
 }
+void OsRequirement::write(QDataStream &stream) const
+{
+	stream << quint8(Kind::Os) << quint8(m_os);
+}
 OsRequirement::Os OsRequirement::fromString(const QString &str)
 {
 	if (str == "linux") {
@@ -94,6 +134,13 @@ QJsonObject AndRequirement::toJson() const
 {
 	return QJsonObject({qMakePair(QStringLiteral("os"), Requirement::toJson(m_children))});
 }
+void AndRequirement::write(QDataStream &stream) const
+{
+	stream << quint8(Kind::And) << quint32(m_children.size());
+	for (const Requirement::Ptr &child : m_children) {
+		child->write(stream);
+	}
+}
 bool AndRequirement::isSatisfied(const ActionContext &ctxt) const
 {
 	return m_children.empty() ||
@@ -105,6 +152,13 @@ QJsonObject OrRequirement::toJson() const
 {
 	return QJsonObject({qMakePair(QStringLiteral("os"), Requirement::toJson(m_children))});
 }
+void OrRequirement::write(QDataStream &stream) const
+{
+	stream << quint8(Kind::Or) << quint32(m_children.size());
+	for (const Requirement::Ptr &child : m_children) {
+		child->write(stream);
+	}
+}
 bool OrRequirement::isSatisfied(const ActionContext &ctxt) const
 {
 	return m_children.empty() ||
@@ -119,6 +173,10 @@ QJsonObject BuildTypeRequirement::toJson() const
 {
 	return QJsonObject({qMakePair(QStringLiteral("os"), m_configuration)});
 }
+void BuildTypeRequirement::write(QDataStream &stream) const
+{
+	stream << quint8(Kind::BuildType) << m_configuration;
+}
 
 bool BuildTypeRequirement::isSatisfied(const ActionContext &ctxt) const
 {
@@ -20,6 +20,7 @@
 #include <memory>
 
 QT_BEGIN_NAMESPACE
+class QDataStream;
 class QJsonArray;
 class QJsonObject;
 class QJsonValue;
@@ -41,7 +42,21 @@ public:
 	static QVector<Requirement::Ptr> fromJson(const QJsonArray &array);
 	static QJsonArray toJson(const QVector<Requirement::Ptr> &requirements);
 
+	/// Binary form for the package cache
+	virtual void write(QDataStream &stream) const = 0;
+	static Requirement::Ptr read(QDataStream &stream);
+
 	virtual bool isSatisfied(const ActionContext &ctxt) const = 0;
+
+protected:
+	// written before each requirement, never change existing values without bumping the cache version
+	enum class Kind : quint8
+	{
+		And,
+		Or,
+		Os,
+		BuildType
+	};
 };
 
 class AndRequirement : public Requirement
@@ -50,6 +65,7 @@ public:
 	explicit AndRequirement(QVector<Requirement::Ptr> &&children) : m_children(std::forward<decltype(children)>(children)) {}
 
 	QJsonObject toJson() const override;
+	void write(QDataStream &stream) const override;
 
 	bool isSatisfied(const ActionContext &ctxt) const override;
 
@@ -62,6 +78,7 @@ public:
 	explicit OrRequirement(QVector<Requirement::Ptr> &&children) : m_children(std::forward<decltype(children)>(children)) {}
 
 	QJsonObject toJson() const override;
+	void write(QDataStream &stream) const override;
 
 	bool isSatisfied(const ActionContext &ctxt) const override;
 
@@ -85,6 +102,7 @@ public:
 	explicit OsRequirement(const QString &string);
 
 	QJsonObject toJson() const override;
+	void write(QDataStream &stream) const override;
 
 	bool isSatisfied(const ActionContext &) const override { return m_os == m_currentOs; }
 
@@ -101,6 +119,7 @@ public:
 	explicit BuildTypeRequirement(const QString &configuration);
 
 	QJsonObject toJson() const override;
+	void write(QDataStream &stream) const override;
 	bool isSatisfied(const ActionContext &ctxt) const override;
 
 private:
@@ -15,6 +15,8 @@
 
 #include "Version.h"
 
+#include <QDataStream>
+
 #include "Functional.h"
 #include "Exception.h"
 
@@ -206,9 +208,10 @@ char Version::compareSections(const QVector<Version::Section> &a, const QVector<
 		} else if (secB.first.isNull()) { // only secA is integer
 			return 1; // #2
 		} else { // both are strings
-			const char value = static_cast<const char>(secA.first.compare(secB.first));
+			// compare() returns any negative or positive number, which does not necessarily fit a char
+			const int value = secA.first.compare(secB.first);
 			if (value != 0) {
-				return value;
+				return value < 0 ? -1 : 1;
 			}
 		}
 	}
@@ -216,5 +219,30 @@ char Version::compareSections(const QVector<Version::Section> &a, const QVector<
 	return 0;
 }
 
+
+QDataStream &operator<<(QDataStream &stream, const Version &version)
+{
+	return stream << version.m_isValid << version.m_typeString << qint32(version.m_type) << version.m_sections;
+}
+QDataStream &operator>>(QDataStream &stream, Version &version)
+{
+	qint32 type;
+	stream >> version.m_isValid >> version.m_typeString >> type >> version.m_sections;
+	version.m_type = Version::Type(type);
+	return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const VersionRequirement &requirement)
+{
+	return stream << requirement.m_version << qint32(requirement.m_type) << requirement.m_allowedTypeString << qint32(requirement.m_allowedType);
+}
+QDataStream &operator>>(QDataStream &stream, VersionRequirement &requirement)
+{
+	qint32 type, allowedType;
+	stream >> requirement.m_version >> type >> requirement.m_allowedTypeString >> allowedType;
+	requirement.m_type = VersionRequirement::Type(type);
+	requirement.m_allowedType = Version::Type(allowedType);
+	return stream;
+}
 }
 }
@@ -18,6 +18,8 @@
 #include <QPair>
 #include <QVector>
 
+class QDataStream;
+
 namespace Ralph {
 namespace ClientLib {
 
@@ -43,10 +45,10 @@ public:
 	QString typeString() const { return m_typeString; }
 	Type type() const { return m_type; }
 
-	inline bool operator<(const Version &other) const { return compareWith(other) == -1; }
-	inline bool operator<=(const Version &other) const { return compareWith(other) != 1; }
-	inline bool operator>(const Version &other) const { return compareWith(other) == 1; }
-	inline bool operator>=(const Version &other) const { return compareWith(other) != -1; }
+	inline bool operator<(const Version &other) const { return compareWith(other) < 0; }
+	inline bool operator<=(const Version &other) const { return compareWith(other) <= 0; }
+	inline bool operator>(const Version &other) const { return compareWith(other) > 0; }
+	inline bool operator>=(const Version &other) const { return compareWith(other) >= 0; }
 	inline bool operator==(const Version &other) const { return compareWith(other) == 0; }
 	inline bool operator!=(const Version &other) const { return compareWith(other) != 0; }
 
@@ -55,7 +57,12 @@ public:
 	static Version fromString(const QString &string);
 	static Type typeFromString(const QString &string);
 
+	// binary form for the package cache
+	friend QDataStream &operator<<(QDataStream &stream, const Version &version);
+	friend QDataStream &operator>>(QDataStream &stream, Version &version);
+
 private:
+	/// -1, 0 or 1
 	char compareWith(const Version &other) const;
 	static char compareSections(const QVector<Section> &a, const QVector<Section> &b);
 
@@ -95,6 +102,9 @@ public:
 	QString toString() const;
 	static VersionRequirement fromString(const QString &string);
 
+	friend QDataStream &operator<<(QDataStream &stream, const VersionRequirement &requirement);
+	friend QDataStream &operator>>(QDataStream &stream, VersionRequirement &requirement);
+
 private:
 	Version m_version;
 	Type m_type;
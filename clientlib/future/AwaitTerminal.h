@@ -1,6 +1,12 @@
 #pragma once
 
+#include <QPair>
+#include <QVector>
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include "FutureWatcher.h"
 #include "TermUtil.h"
@@ -12,28 +18,150 @@ template <typename T>
 T awaitTerminal(const Future<T> &future)
 {
 	using namespace Common;
-	const int maxWidth = Term::currentWidth() == 0 ? 120 : Term::currentWidth();
+	// signals might arrive on other threads, which have to write to where we do
+	const Term::Output &output = Term::Output::current();
+	const int maxWidth = output.width() == 0 ? 120 : output.width();
 
 	FutureWatcher<T> watcher(future);
-	FutureWatcher<T>::connect(&watcher, &FutureWatcher<T>::status, [maxWidth](const QString &str)
+	FutureWatcher<T>::connect(&watcher, &FutureWatcher<T>::status, [&output, maxWidth](const QString &str)
 	{
-		std::cout << Term::wrap(str, maxWidth - 6) << std::endl;
+		const Term::Output::Scope scope(output);
+		output.out() << Term::wrap(str, maxWidth - 6) << std::endl;
 	});
-	FutureWatcher<T>::connect(&watcher, &FutureWatcher<T>::progress, [maxWidth](const std::size_t current, const std::size_t total)
+	FutureWatcher<T>::connect(&watcher, &FutureWatcher<T>::progress, [&output, maxWidth](const std::size_t current, const std::size_t total)
 	{
-		if (Term::isTty()) {
+		const Term::Output::Scope scope(output);
+		if (output.isTty()) {
 			const int percent = int(std::floor(100 * qreal(current) / qreal(total)));
-			std::cout << Term::save() << Term::move(Term::Up) << Term::move(Term::Right, maxWidth - 6) << "[";
+			output.out() << Term::save() << Term::move(Term::Up) << Term::move(Term::Right, maxWidth - 6) << "[";
 			if (percent < 10) {
-				std::cout << "  ";
+				output.out() << "  ";
 			} else if (percent < 100) {
-				std::cout << " ";
+				output.out() << " ";
 			}
-			std::cout << percent << "%]" << Term::restore() << std::flush;
+			output.out() << percent << "%]" << Term::restore() << std::flush;
 		}
 	});
 	return await(future);
 }
 
+/// Like awaitTerminal, for a future made up of parts that run at the same time, like the packages of a PackageInstaller.
+/// On a terminal every running part has a line of its own that is updated in place, below the parts that have finished.
+template <typename T>
+T awaitTerminal(const Future<T> &future, const QVector<QPair<QString, Future<void>>> &parts)
+{
+	using namespace Common;
+	// see above, every slot makes this the current output of whatever thread it runs on
+	const Term::Output &output = Term::Output::current();
+	const int maxWidth = output.width() == 0 ? 120 : output.width();
+	int labelWidth = 0;
+	for (const auto &part : parts) {
+		labelWidth = std::max(labelWidth, part.first.size());
+	}
+
+	struct Line
+	{
+		QString status;
+		int percent = -1;
+	};
+	// signals arrive both from the sampler thread and from whoever finishes a part
+	std::mutex mutex;
+	QVector<Line> lines(parts.size());
+	QVector<int> running;
+	int drawn = 0;
+
+	auto text = [&parts, &lines, labelWidth, maxWidth](const int index)
+	{
+		const Line &line = lines.at(index);
+		const QString out = (parts.at(index).first.leftJustified(labelWidth) + "  " + line.status).left(maxWidth - 7);
+		return line.percent < 0 ? out : out.leftJustified(maxWidth - 7) + QString(" [%1%]").arg(line.percent, 3);
+	};
+	// the lines of the running parts are drawn again from scratch, with finished (if any) above them for good
+	auto redraw = [&output, &running, &drawn, &text](const QString &finished)
+	{
+		std::ostream &out = output.out();
+		if (drawn > 0) {
+			out << Term::move(Term::LineUp, drawn);
+		}
+		const int now = running.size() + (finished.isNull() ? 0 : 1);
+		if (!finished.isNull()) {
+			out << Term::clearLine() << finished << '\n';
+		}
+		for (const int index : running) {
+			out << Term::clearLine() << text(index) << '\n';
+		}
+		for (int i = now; i < drawn; ++i) {
+			out << Term::clearLine() << '\n';
+		}
+		if (drawn > now) {
+			out << Term::move(Term::LineUp, drawn - now);
+		}
+		drawn = running.size();
+		out << std::flush;
+	};
+	auto done = [&output, &mutex, &parts, &lines, &running, &redraw, &text](const int index, const QString &outcome)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running.removeOne(index);
+		lines[index].percent = -1;
+		if (output.isTty()) {
+			redraw(text(index) + ' ' + outcome);
+		} else {
+			output.out() << parts.at(index).first << ": " << outcome << std::endl;
+		}
+	};
+
+	std::vector<std::unique_ptr<FutureWatcher<void>>> watchers;
+	for (int i = 0; i < parts.size(); ++i) {
+		watchers.push_back(std::make_unique<FutureWatcher<void>>(parts.at(i).second));
+		FutureWatcher<void> *watcher = watchers.back().get();
+		FutureWatcher<void>::connect(watcher, &FutureWatcher<void>::started, [i, &output, &mutex, &running, &redraw]()
+		{
+			const Term::Output::Scope scope(output);
+			std::lock_guard<std::mutex> lock(mutex);
+			running.append(i);
+			if (output.isTty()) {
+				redraw(QString());
+			}
+		});
+		FutureWatcher<void>::connect(watcher, &FutureWatcher<void>::status, [i, &output, &mutex, &parts, &lines, &redraw](const QString &str)
+		{
+			const Term::Output::Scope scope(output);
+			std::lock_guard<std::mutex> lock(mutex);
+			lines[i].status = str.simplified();
+			if (output.isTty()) {
+				redraw(QString());
+			} else {
+				output.out() << parts.at(i).first << ": " << lines.at(i).status << std::endl;
+			}
+		});
+		FutureWatcher<void>::connect(watcher, &FutureWatcher<void>::progress, [i, &output, &mutex, &lines, &redraw](const std::size_t current, const std::size_t total)
+		{
+			const Term::Output::Scope scope(output);
+			if (output.isTty()) {
+				std::lock_guard<std::mutex> lock(mutex);
+				lines[i].percent = int(std::floor(100 * qreal(current) / qreal(total)));
+				redraw(QString());
+			}
+		});
+		FutureWatcher<void>::connect(watcher, &FutureWatcher<void>::finished, [i, &output, &done]()
+		{
+			const Term::Output::Scope scope(output);
+			done(i, Term::fg(Term::Green, "done"));
+		});
+		FutureWatcher<void>::connect(watcher, &FutureWatcher<void>::exception, [i, &output, &done]()
+		{
+			const Term::Output::Scope scope(output);
+			done(i, Term::fg(Term::Red, "failed"));
+		});
+		FutureWatcher<void>::connect(watcher, &FutureWatcher<void>::canceled, [i, &output, &done]()
+		{
+			const Term::Output::Scope scope(output);
+			done(i, Term::fg(Term::Yellow, "canceled"));
+		});
+	}
+	return await(future);
+}
+
 }
 }
@@ -15,20 +15,63 @@
 
 #include "Future.h"
 
+#include <algorithm>
+
+#include "WatcherSampler_p.h"
+#include "task/Executor.h"
+#include "task/Trace.h"
+
 namespace Ralph {
 namespace ClientLib {
 namespace Private {
 
+// set by cancelAll(), for example from a signal handler, so it has to stay lock-free
+static std::atomic<bool> s_cancelAll{false};
+
 BaseFutureData::~BaseFutureData() {}
 BaseFuture::~BaseFuture() {}
 
 void BaseFuture::addWatcher(BaseFutureWatcher *watcher)
 {
-	d->watchers.insert(watcher);
+	{
+		std::lock_guard<std::mutex> lock(d->watcherMutex);
+		d->watchers.push_back(watcher);
+		d->watched = true;
+	}
+	WatcherSampler::instance()->add(d);
 }
 void BaseFuture::removeWatcher(BaseFutureWatcher *watcher)
 {
-	d->watchers.erase(watcher);
+	// waits for other threads emitting to watcher, but not for this one (which might be in one of its slots)
+	std::lock_guard<std::recursive_mutex> emitLock(d->emitMutex);
+	std::lock_guard<std::mutex> lock(d->watcherMutex);
+	d->watchers.erase(std::remove(d->watchers.begin(), d->watchers.end(), watcher), d->watchers.end());
+	if (d->watchers.empty()) {
+		d->watched = false;
+		WatcherSampler::instance()->remove(d.get());
+	}
+}
+void BaseFuture::addContinuation(std::function<void()> &&func)
+{
+	d->addContinuation(std::move(func));
+}
+void BaseFuture::cancel()
+{
+	d->cancelRequested = true;
+}
+bool BaseFuture::isCancelRequested() const
+{
+	return d->isCancelRequested();
+}
+void BaseFuture::share(const BasePromise &promise)
+{
+	std::lock_guard<std::mutex> lock(d->sharersMutex);
+	d->sharers.push_back(std::make_shared<BasePromise>(promise));
+}
+bool BaseFuture::hasFailed() const
+{
+	std::unique_lock<std::mutex> lock(d->mutex);
+	return d->state == BaseFutureData::Exception || d->state == BaseFutureData::Canceled;
 }
 void BaseFuture::start()
 {
@@ -36,8 +79,7 @@ void BaseFuture::start()
 }
 void BaseFuture::waitForFinished()
 {
-	d->start();
-	d->future.wait();
+	d->waitForFinished();
 }
 
 void BaseFutureData::start()
@@ -47,10 +89,142 @@ void BaseFutureData::start()
 		return;
 	}
 	state = BaseFutureData::Running;
-	// reporting will be done from the other thread
-	startupMutex.unlock();
+	if (Trace::isEnabled()) {
+		traceScheduledAt = Trace::now();
+	}
+	const bool submit = hasJob && policy != std::launch::deferred && !slotLent;
+	lock.unlock();
+
+	if (submit) {
+		std::shared_ptr<BaseFutureData> self = shared_from_this();
+		ResourceLimits::submit(resource, [self]()
+		{
+			self->holdsSlot = true;
+			self->run();
+		});
+	}
+}
+bool BaseFutureData::isCancelRequested()
+{
+	if (cancelRequested || s_cancelAll) {
+		return true;
+	}
+	const std::shared_ptr<BasePromise> delegate = std::atomic_load(&delegateTo);
+	// whoever is awaiting us might have been canceled
+	if (delegate && delegate->isCancelRequested()) {
+		return true;
+	}
+	const std::vector<std::shared_ptr<BasePromise>> all = currentSharers();
+	return !all.empty() && std::all_of(all.cbegin(), all.cend(), [](const std::shared_ptr<BasePromise> &sharer) { return sharer->isCancelRequested(); });
+}
+std::vector<std::shared_ptr<BasePromise>> BaseFutureData::currentSharers()
+{
+	std::lock_guard<std::mutex> lock(sharersMutex);
+	return sharers;
+}
+void BaseFutureData::run()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		// might already have been taken by another thread
+		if (!hasJob) {
+			return;
+		}
+		hasJob = false;
+	}
+	execute();
+}
+void BaseFutureData::execute()
+{
+	std::function<void()> func = std::move(job);
+	job = nullptr;
+	if (func) {
+		func();
+	}
+}
+void BaseFutureData::complete()
+{
+	std::vector<std::function<void()>> pending;
+	// released outside the lock, tasks usually keep themselves alive through us
+	std::vector<std::shared_ptr<void>> keptAlive;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		completed = true;
+		pending.swap(continuations);
+		keptAlive.swap(tasks);
+	}
+	for (std::function<void()> &continuation : pending) {
+		Executor::instance()->submit(std::move(continuation));
+	}
+	if (waiters > 0) {
+		Executor::instance()->wake();
+	}
+}
+std::uint64_t BaseFutureData::ensureTraceId()
+{
+	std::uint64_t id = traceId;
+	if (id == 0) {
+		const std::uint64_t fresh = Trace::nextId();
+		// somebody else might have been faster, in which case id now contains theirs
+		id = traceId.compare_exchange_strong(id, fresh) ? fresh : id;
+	}
+	return id;
+}
+void BaseFutureData::addContinuation(std::function<void()> &&func)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!completed) {
+			continuations.push_back(std::move(func));
+			func = nullptr;
+		}
+	}
+	if (func) {
+		Executor::instance()->submit(std::move(func));
+		return;
+	}
+
+	// nobody might ever wait for us, so deferred jobs need to be scheduled as well
+	start();
+	if (policy == std::launch::deferred) {
+		std::shared_ptr<BaseFutureData> self = shared_from_this();
+		Executor::instance()->submit([self]() { self->run(); });
+	}
+}
+void BaseFutureData::waitForFinished()
+{
+	start();
+	if (future.valid()) {
+		future.wait();
+		return;
+	}
+	bool runHere;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		runHere = policy == std::launch::deferred || slotLent;
+		if (slotLent) {
+			holdsSlot = true;
+		}
+	}
+	if (runHere) {
+		run();
+	}
+	// run other jobs while waiting, the job we are waiting for might be one of them
+	++waiters;
+	Executor::instance()->helpUntil([this]()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return completed;
+	});
+	--waiters;
 }
 
 }
+
+void cancelAll()
+{
+	Private::s_cancelAll = true;
+}
+
 }
 }
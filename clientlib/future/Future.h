@@ -26,6 +26,7 @@
 #include "Functional.h"
 #include "FutureData_p.h"
 #include "Promise.h"
+#include "task/Trace.h"
 
 namespace Ralph {
 namespace ClientLib {
@@ -38,6 +39,11 @@ namespace Private {
 class BaseFutureWatcher;
 }
 
+DECLARE_EXCEPTION(Canceled);
+
+/// Requests cancelation of all futures, for example when the user hits Ctrl-C. Safe to call from signal handlers.
+void cancelAll();
+
 namespace Private {
 class BaseFuture
 {
@@ -52,6 +58,19 @@ public:
 
 	void waitForFinished();
 
+	/// Runs func on the Executor once this future has finished (or right away if it already has)
+	void addContinuation(std::function<void()> &&func);
+
+	/// Asks the task to stop as soon as possible, this includes everything it is currently awaiting
+	void cancel();
+	bool isCancelRequested() const;
+	/// True if the future finished with an exception or was canceled
+	bool hasFailed() const;
+
+	/// Forwards status and progress to promise as well, once something is shared the task is only asked to
+	/// stop once everybody sharing it has been canceled (see SingleFlight)
+	void share(const BasePromise &promise);
+
 protected:
 	friend class BasePromise;
 	template <typename T> std::shared_ptr<Private::FutureData<T>> d_func() const { return std::static_pointer_cast<Private::FutureData<T>>(d); }
@@ -60,6 +79,90 @@ protected:
 };
 }
 
+/// Handed to tasks and continuations for reporting status and progress, awaiting other futures and checking for cancelation
+class Notifier
+{
+	mutable Private::BasePromise m_promise;
+public:
+	template <typename T>
+	explicit Notifier(Task<T> *task)
+		: m_promise(task->m_promise) {}
+	explicit Notifier(const Private::BasePromise &promise)
+		: m_promise(promise) {}
+
+	void status(const QString &status) const { m_promise.reportStatus(status); }
+	void progress(const std::size_t current, const std::size_t total) const { m_promise.reportProgress(current, total); }
+
+	/// Long running tasks should check this regularly and stop as soon as possible if it is true
+	bool isCanceled() const { return m_promise.isCancelRequested(); }
+	/// Throws a CanceledException if isCanceled()
+	void checkCanceled() const
+	{
+		if (isCanceled()) {
+			throw CanceledException("The operation was canceled");
+		}
+	}
+
+	/// Blocks until future has finished, prefer Future::then where possible. If it is of the same resource class as
+	/// the task we belong to it runs on our slot, see ResourceLimits
+	template <typename T>
+	inline T await(const Future<T> &future) const
+	{
+		return m_promise.await(future);
+	}
+};
+template <>
+inline void Notifier::await<void>(const Future<void> &future) const
+{
+	m_promise.await(future);
+}
+
+namespace Private {
+using Common::Functional::FunctionTraits;
+
+template <typename T> struct Unwrapped { using Type = T; };
+template <typename T> struct Unwrapped<Future<T>> { using Type = T; };
+template <typename T> struct IsFuture : std::false_type {};
+template <typename T> struct IsFuture<Future<T>> : std::true_type {};
+
+// continuations may take a Notifier as their last argument
+template <typename Func, typename... Args>
+std::enable_if_t<FunctionTraits<Func>::arity == sizeof...(Args), typename FunctionTraits<Func>::ReturnType>
+callContinuation(Func &func, const Notifier &, Args &&... args)
+{
+	return func(std::forward<Args>(args)...);
+}
+template <typename Func, typename... Args>
+std::enable_if_t<FunctionTraits<Func>::arity == sizeof...(Args) + 1, typename FunctionTraits<Func>::ReturnType>
+callContinuation(Func &func, const Notifier &notifier, Args &&... args)
+{
+	return func(std::forward<Args>(args)..., notifier);
+}
+
+/// Like fulfil, but if func returns a future the promise is only fulfilled once that has finished, without waiting for it
+template <typename T, typename Func>
+std::enable_if_t<!IsFuture<std::decay_t<std::result_of_t<Func()>>>::value, void>
+settle(Promise<T> &promise, Func &&func)
+{
+	fulfil(promise, std::forward<Func>(func));
+}
+template <typename T, typename Func>
+std::enable_if_t<IsFuture<std::decay_t<std::result_of_t<Func()>>>::value, void>
+settle(Promise<T> &promise, Func &&func)
+{
+	try {
+		Future<T> inner = func();
+		promise.adopt(inner);
+		inner.addContinuation([promise, inner]() mutable
+		{
+			fulfil(promise, [&inner]() { return inner.result(); });
+		});
+	} catch (...) {
+		promise.reportException(std::current_exception());
+	}
+}
+}
+
 QT_WARNING_PUSH
 QT_WARNING_DISABLE_GCC("-Wweak-vtables")
 template <typename T>
@@ -77,9 +180,31 @@ public:
 		std::unique_lock<std::mutex> lock(d->mutex);
 		if (d->state == Private::FutureData<T>::Exception && d->exception) {
 			d->exception->rethrow();
+		} else if (d->state == Private::FutureData<T>::Canceled) {
+			throw CanceledException("The operation was canceled");
 		}
 		return d_func<T>()->result;
 	}
+
+	/**
+	 * Calls func with the result once this future has finished, without blocking a thread in the meantime.
+	 *
+	 * func may take a Notifier as second argument. If func returns a future the returned future finishes
+	 * once that one has finished, which allows chaining asynchronous steps without awaiting them.
+	 */
+	template <typename Func, typename R = typename Private::Unwrapped<std::decay_t<typename Common::Functional::FunctionTraits<std::decay_t<Func>>::ReturnType>>::Type>
+	Future<R> then(Func &&func)
+	{
+		Promise<R> promise;
+		promise.adopt(*this);
+		Future<T> self = *this;
+		addContinuation([promise, self, func]() mutable
+		{
+			const Notifier notifier(promise);
+			Private::settle(promise, [&self, &func, &notifier]() { return Private::callContinuation(func, notifier, self.result()); });
+		});
+		return promise.future();
+	}
 };
 template <>
 class Future<void> : public Private::BaseFuture
@@ -96,8 +221,25 @@ public:
 		std::unique_lock<std::mutex> lock(d->mutex);
 		if (d->state == Private::FutureData<void>::Exception && d->exception) {
 			d->exception->rethrow();
+		} else if (d->state == Private::FutureData<void>::Canceled) {
+			throw CanceledException("The operation was canceled");
 		}
 	}
+
+	/// Calls func once this future has finished, without blocking a thread in the meantime, see Future<T>::then
+	template <typename Func, typename R = typename Private::Unwrapped<std::decay_t<typename Common::Functional::FunctionTraits<std::decay_t<Func>>::ReturnType>>::Type>
+	Future<R> then(Func &&func)
+	{
+		Promise<R> promise;
+		promise.adopt(*this);
+		Future<void> self = *this;
+		addContinuation([promise, self, func]() mutable
+		{
+			const Notifier notifier(promise);
+			Private::settle(promise, [&self, &func, &notifier]() { self.result(); return Private::callContinuation(func, notifier); });
+		});
+		return promise.future();
+	}
 };
 QT_WARNING_POP
 
@@ -114,11 +256,23 @@ template <typename OtherT>
 OtherT Private::BasePromise::await(const Future<OtherT> &other)
 {
 	Future<OtherT> future{other};
-	future.d->delegateTo = std::make_shared<BasePromise>(*this);
+	const std::int64_t traceStart = Trace::isEnabled() ? traceAwaitBegin(future.d) : 0;
+	std::atomic_store(&future.d->delegateTo, std::make_shared<BasePromise>(*this));
+	lendSlot(future.d);
 	future.waitForFinished();
-	future.d->delegateTo.reset();
+	std::atomic_store(&future.d->delegateTo, std::shared_ptr<BasePromise>());
+	if (Trace::isEnabled()) {
+		traceAwaitEnd(future.d, traceStart);
+	}
 	return future.result();
 }
+template <typename OtherT>
+void Private::BasePromise::adopt(const Future<OtherT> &other)
+{
+	Future<OtherT> future{other};
+	std::shared_ptr<BasePromise> expected;
+	std::atomic_compare_exchange_strong(&future.d->delegateTo, &expected, std::make_shared<BasePromise>(*this));
+}
 
 template <typename T>
 T await(Future<T> future)
@@ -126,5 +280,20 @@ T await(Future<T> future)
 	return future.result();
 }
 
+/// A future that has already finished with value, for example for returning from one branch of a continuation
+template <typename T>
+Future<std::decay_t<T>> makeReadyFuture(T &&value)
+{
+	Promise<std::decay_t<T>> promise;
+	Private::fulfil(promise, [&value]() { return std::forward<T>(value); });
+	return promise.future();
+}
+inline Future<void> makeReadyFuture()
+{
+	Promise<void> promise;
+	Private::fulfil(promise, []() {});
+	return promise.future();
+}
+
 }
 }
@@ -0,0 +1,115 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QVector>
+#include <atomic>
+
+#include "Future.h"
+
+namespace Ralph {
+namespace ClientLib {
+
+namespace Private {
+template <typename Result, typename T, typename Collect>
+Future<Result> whenAllImpl(const QVector<Future<T>> &futures, Collect &&collect)
+{
+	struct State
+	{
+		Promise<Result> promise;
+		QVector<Future<T>> futures;
+		std::atomic<int> remaining;
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+	state->futures = futures;
+	state->remaining = futures.size();
+
+	auto finish = [state, collect]() { fulfil(state->promise, [state, collect]() { return collect(state->futures); }); };
+	if (futures.isEmpty()) {
+		finish();
+	}
+	for (Future<T> future : futures) {
+		state->promise.adopt(future);
+		future.addContinuation([state, future, finish]()
+		{
+			// no need to keep the others running if we are going to fail anyway
+			if (future.hasFailed()) {
+				for (Future<T> &other : state->futures) {
+					other.cancel();
+				}
+			}
+			if (--state->remaining == 0) {
+				finish();
+			}
+		});
+	}
+	return state->promise.future();
+}
+}
+
+/// Finishes once all futures have finished, with their results in the same order. Rethrows the first exception
+/// and cancels the remaining futures as soon as one fails.
+template <typename T>
+Future<QVector<T>> whenAll(const QVector<Future<T>> &futures)
+{
+	return Private::whenAllImpl<QVector<T>>(futures, [](QVector<Future<T>> &all)
+	{
+		QVector<T> results;
+		results.reserve(all.size());
+		for (Future<T> &future : all) {
+			results.append(future.result());
+		}
+		return results;
+	});
+}
+inline Future<void> whenAll(const QVector<Future<void>> &futures)
+{
+	return Private::whenAllImpl<void>(futures, [](QVector<Future<void>> &all)
+	{
+		for (Future<void> &future : all) {
+			future.result();
+		}
+	});
+}
+
+/// Finishes as soon as any of the futures has finished, with the index of that future
+template <typename T>
+Future<int> whenAny(const QVector<Future<T>> &futures)
+{
+	struct State
+	{
+		Promise<int> promise;
+		std::atomic<bool> done{false};
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+
+	if (futures.isEmpty()) {
+		Private::fulfil(state->promise, []() -> int { throw Exception("whenAny requires at least one future"); });
+	}
+	for (int i = 0; i < futures.size(); ++i) {
+		Future<T> future = futures.at(i);
+		future.addContinuation([state, i]()
+		{
+			if (!state->done.exchange(true)) {
+				Private::fulfil(state->promise, [i]() { return i; });
+			}
+		});
+	}
+	return state->promise.future();
+}
+
+}
+}
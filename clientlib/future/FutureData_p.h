@@ -16,16 +16,21 @@
 #pragma once
 
 #include <QString>
+#include <QStringList>
 #include <QPointer>
 #include <QSemaphore>
 
+#include <functional>
+#include <atomic>
+#include <cstdint>
 #include <future>
 #include <mutex>
 #include <memory>
-#include <unordered_set>
+#include <vector>
 
 #include "Functional.h"
 #include "WrappedException.h"
+#include "task/Resource.h"
 
 namespace Ralph {
 namespace ClientLib {
@@ -38,7 +43,7 @@ class BasePromise;
 }
 
 namespace Private {
-class BaseFutureData
+class BaseFutureData : public std::enable_shared_from_this<BaseFutureData>
 {
 public:
 	virtual ~BaseFutureData();
@@ -48,17 +53,76 @@ public:
 	std::mutex mutex;
 
 	void start();
-	std::mutex startupMutex;
+	void run();
+	void complete();
+	void waitForFinished();
 
-	std::size_t progressCurrent = 0;
-	std::size_t progressTotal = 0;
+	// set by cancel(), canceling a future also cancels everything it is awaiting (see isCancelRequested)
+	std::atomic<bool> cancelRequested{false};
+	bool isCancelRequested();
+
+	// deferred jobs are run by the first thread waiting for them, others are submitted to the Executor on start()
+	std::launch policy = std::launch::deferred;
+	// jobs that are submitted go through ResourceLimits
+	Resource resource = Resource::Cpu;
+	// set while the job runs on a slot of its resource class, jobs of the same class it awaits run on that slot as well
+	std::atomic<bool> holdsSlot{false};
+	// set by a task holding a slot of our resource class that awaits us, we run on its thread and slot instead of
+	// waiting for one of our own (which might never come, since it is holding it)
+	bool slotLent = false;
+	// set while there is a job that has not been taken by run() yet
+	bool hasJob = false;
+	std::function<void()> job;
+	bool completed = false;
+	// threads blocked in waitForFinished, complete() only has to wake anybody if there are some
+	std::atomic<int> waiters{0};
+	/// Runs the job, task frames (see async()) override this instead of going through job
+	virtual void execute();
+
+	// run on the Executor once completed
+	void addContinuation(std::function<void()> &&func);
+	std::vector<std::function<void()>> continuations;
+
+	// progress is reported far more often than anybody could look at it, so it is only stored here and
+	// watchers get the latest value at a bounded rate (see WatcherSampler) and once more on completion
+	std::atomic<std::size_t> progressCurrent{0};
+	std::atomic<std::size_t> progressTotal{0};
+	std::atomic<std::uint64_t> progressGeneration{0};
 	std::shared_ptr<WrappedException> exception;
+
+	// status messages are not coalesced, but only queued if somebody is watching
+	std::mutex statusMutex;
 	QString status;
+	QStringList pendingStatus;
 
+	// only accessed through std::atomic_load/std::atomic_store, it is read on every report
 	std::shared_ptr<Private::BasePromise> delegateTo;
-	std::unordered_set<std::shared_ptr<void>> tasks;
+	// like delegateTo, but for several promises sharing the same work (see BaseFuture::share), which only
+	// counts as canceled once all of them are
+	std::mutex sharersMutex;
+	std::vector<std::shared_ptr<Private::BasePromise>> sharers;
+	std::vector<std::shared_ptr<Private::BasePromise>> currentSharers();
+	// kept alive until completed, most futures never have any so this only allocates when used
+	std::vector<std::shared_ptr<void>> tasks;
+
+	// guards watchers, but is not held while emitting, slots may remove (and delete) their watcher
+	std::mutex watcherMutex;
+	std::vector<BaseFutureWatcher *> watchers;
+	std::atomic<bool> watched{false};
+	// held while emitting and by removeWatcher, so a watcher can not go away while another thread notifies it
+	std::recursive_mutex emitMutex;
+	std::uint64_t progressGenerationReported = 0;
+	/// Calls func for every watcher, skipping those that are removed in the meantime
+	void forEachWatcher(const std::function<void(BaseFutureWatcher *)> &func);
+	/// Delivers queued status messages and the latest progress (if it changed) to all watchers
+	void flushToWatchers();
 
-	std::unordered_set<BaseFutureWatcher *> watchers;
+	// only used while tracing is enabled (see Trace), the name is the first reported status message
+	std::atomic<std::uint64_t> traceId{0};
+	std::int64_t traceScheduledAt = -1;
+	std::int64_t traceStartedAt = -1;
+	QString traceName;
+	std::uint64_t ensureTraceId();
 };
 
 QT_WARNING_PUSH
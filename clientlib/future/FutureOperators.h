@@ -16,46 +16,55 @@
 #pragma once
 
 #include "Future.h"
-#include "task/Task.h"
+#include "FutureCombinators.h"
 
 namespace Ralph {
 namespace ClientLib {
 
+namespace Private {
+// evaluates both operands concurrently, then applies func to the results
+template <typename A, typename B, typename Func>
+inline auto combine(Future<A> a, Future<B> b, Func &&func)
+{
+	return whenAll(QVector<Future<void>>{a, b}).then([a, b, func]() mutable { return func(a.result(), b.result()); });
+}
+}
+
 template <typename A, typename B>
 inline auto operator +(Future<A> a, Future<B> b)
 {
-	return async(std::launch::deferred, [&a, &b]() { return a.result() + b.result(); });
+	return Private::combine(a, b, [](const A &x, const B &y) { return x + y; });
 }
 template <typename A, typename B>
 inline auto operator -(Future<A> a, Future<B> b)
 {
-	return async(std::launch::deferred, [&a, &b]() { return a.result() - b.result(); });
+	return Private::combine(a, b, [](const A &x, const B &y) { return x - y; });
 }
 template <typename A, typename B>
 inline auto operator *(Future<A> a, Future<B> b)
 {
-	return async(std::launch::deferred, [&a, &b]() { return a.result() * b.result(); });
+	return Private::combine(a, b, [](const A &x, const B &y) { return x * y; });
 }
 template <typename A, typename B>
 inline auto operator /(Future<A> a, Future<B> b)
 {
-	return async(std::launch::deferred, [&a, &b]() { return a.result() / b.result(); });
+	return Private::combine(a, b, [](const A &x, const B &y) { return x / y; });
 }
 template <typename A, typename B>
 inline auto operator %(Future<A> a, Future<B> b)
 {
-	return async(std::launch::deferred, [&a, &b]() { return a.result() % b.result(); });
+	return Private::combine(a, b, [](const A &x, const B &y) { return x % y; });
 }
 
 template <typename A, typename B>
 inline auto operator &&(Future<A> a, Future<B> b)
 {
-	return async(std::launch::deferred, [&a, &b]() { return a.result() && b.result(); });
+	return Private::combine(a, b, [](const A &x, const B &y) { return x && y; });
 }
 template <typename A, typename B>
 inline auto operator ||(Future<A> a, Future<B> b)
 {
-	return async(std::launch::deferred, [&a, &b]() { return a.result() || b.result(); });
+	return Private::combine(a, b, [](const A &x, const B &y) { return x || y; });
 }
 
 }
@@ -15,7 +15,10 @@
 
 #include "Promise.h"
 
+#include <algorithm>
+
 #include "FutureWatcher.h"
+#include "task/Trace.h"
 
 namespace Ralph {
 namespace ClientLib {
@@ -24,15 +27,50 @@ namespace Private {
 template <typename Func, typename... Args>
 void BasePromise::report(Func &&func, Args&&... args)
 {
-	for (BaseFutureWatcher *watcher : d->watchers) {
-		emit (watcher->*func)(args...);
-	}
+	d->forEachWatcher([&func, &args...](BaseFutureWatcher *watcher) { emit (watcher->*func)(args...); });
 }
 
-BasePromise::BasePromise(const std::shared_ptr<BaseFutureData> &other) : d(other)
+void BaseFutureData::forEachWatcher(const std::function<void(BaseFutureWatcher *)> &func)
 {
-	d->startupMutex.lock();
+	std::lock_guard<std::recursive_mutex> emitLock(emitMutex);
+	std::vector<BaseFutureWatcher *> copy;
+	{
+		std::lock_guard<std::mutex> lock(watcherMutex);
+		copy = watchers;
+	}
+	for (BaseFutureWatcher *watcher : copy) {
+		{
+			// other threads can not remove watchers while we hold emitMutex, but a slot on this thread can
+			std::lock_guard<std::mutex> lock(watcherMutex);
+			if (std::find(watchers.cbegin(), watchers.cend(), watcher) == watchers.cend()) {
+				continue;
+			}
+		}
+		func(watcher);
+	}
 }
+void BaseFutureData::flushToWatchers()
+{
+	std::lock_guard<std::recursive_mutex> emitLock(emitMutex);
+	QStringList messages;
+	{
+		std::lock_guard<std::mutex> statusLock(statusMutex);
+		messages.swap(pendingStatus);
+	}
+	for (const QString &message : messages) {
+		forEachWatcher([&message](BaseFutureWatcher *watcher) { emit watcher->status(message); });
+	}
+
+	const std::uint64_t generation = progressGeneration;
+	if (generation != progressGenerationReported) {
+		progressGenerationReported = generation;
+		const std::size_t current = progressCurrent;
+		const std::size_t total = progressTotal;
+		forEachWatcher([current, total](BaseFutureWatcher *watcher) { emit watcher->progress(current, total); });
+	}
+}
+
+BasePromise::BasePromise(const std::shared_ptr<BaseFutureData> &other) : d(other) {}
 
 BasePromise::~BasePromise() {}
 
@@ -42,10 +80,24 @@ void BasePromise::prime(std::future<void> &&future)
 	Q_ASSERT(!d->future.valid());
 	d->future = std::forward<std::future<void>>(future);
 }
+void BasePromise::prime(const std::launch policy, std::function<void()> &&job)
+{
+	std::unique_lock<std::mutex> lock(d->mutex);
+	Q_ASSERT(!d->hasJob);
+	d->policy = policy;
+	d->job = std::move(job);
+	d->hasJob = true;
+}
 void BasePromise::reportStarted()
 {
-	// setting the state is done from BaseFutureData::start
-	d->startupMutex.lock();
+	// setting the state is done from BaseFutureData::start, which is also what schedules us
+	if (Trace::isEnabled()) {
+		d->traceStartedAt = Trace::now();
+		// ends the arrow from whoever awaited us, if anybody did
+		if (d->traceId != 0) {
+			Trace::flowEnd(d->traceId, d->traceStartedAt);
+		}
+	}
 	report(&BaseFutureWatcher::started);
 }
 void BasePromise::reportFinished()
@@ -54,7 +106,12 @@ void BasePromise::reportFinished()
 		std::unique_lock<std::mutex> lock(d->mutex);
 		d->state = Private::BaseFutureData::Finished;
 	}
+	if (Trace::isEnabled()) {
+		traceCompleted("finished");
+	}
+	d->flushToWatchers();
 	report(&BaseFutureWatcher::finished);
+	d->complete();
 }
 void BasePromise::reportCanceled()
 {
@@ -62,45 +119,126 @@ void BasePromise::reportCanceled()
 		std::unique_lock<std::mutex> lock(d->mutex);
 		d->state = Private::BaseFutureData::Canceled;
 	}
+	if (Trace::isEnabled()) {
+		traceCompleted("canceled");
+	}
+	d->flushToWatchers();
 	report(&BaseFutureWatcher::canceled);
+	d->complete();
 }
 void BasePromise::reportProgress(const std::size_t current, const std::size_t total)
 {
-	{
-		std::unique_lock<std::mutex> lock(d->mutex);
-		d->progressCurrent = current;
-		d->progressTotal = total;
-	}
-	report(&BaseFutureWatcher::progress, current, total);
+	// called from transfer callbacks thousands of times per second, watchers get sampled values (see WatcherSampler)
+	d->progressTotal.store(total, std::memory_order_relaxed);
+	d->progressCurrent.store(current, std::memory_order_relaxed);
+	d->progressGeneration.fetch_add(1, std::memory_order_release);
 
-	if (d->delegateTo) {
-		d->delegateTo->reportProgress(current, total);
+	if (const std::shared_ptr<BasePromise> delegate = std::atomic_load(&d->delegateTo)) {
+		delegate->reportProgress(current, total);
+	}
+	for (const std::shared_ptr<BasePromise> &sharer : d->currentSharers()) {
+		sharer->reportProgress(current, total);
 	}
 }
 void BasePromise::reportStatus(const QString &message)
+{
+	if (Trace::isEnabled()) {
+		{
+			std::lock_guard<std::mutex> lock(d->statusMutex);
+			if (d->traceName.isEmpty()) {
+				d->traceName = message;
+			}
+		}
+		QJsonObject args;
+		args.insert("task", qint64(d->ensureTraceId()));
+		Trace::instant(message, args);
+	}
+	forwardStatus(message);
+}
+void BasePromise::reportException(const std::exception_ptr &exception)
+{
+	propagateException(exception);
+	if (Trace::isEnabled()) {
+		traceCompleted("exception");
+	}
+	d->complete();
+}
+void BasePromise::forwardStatus(const QString &message)
 {
 	{
-		std::unique_lock<std::mutex> lock(d->mutex);
+		std::lock_guard<std::mutex> lock(d->statusMutex);
 		d->status = message;
+		if (d->watched) {
+			d->pendingStatus.append(message);
+		}
 	}
-	report(&BaseFutureWatcher::status, message);
 
-	if (d->delegateTo) {
-		d->delegateTo->reportStatus(message);
+	if (const std::shared_ptr<BasePromise> delegate = std::atomic_load(&d->delegateTo)) {
+		delegate->forwardStatus(message);
+	}
+	for (const std::shared_ptr<BasePromise> &sharer : d->currentSharers()) {
+		sharer->forwardStatus(message);
 	}
 }
-void BasePromise::reportException(const std::exception_ptr &exception)
+void BasePromise::propagateException(const std::exception_ptr &exception)
 {
 	{
 		std::unique_lock<std::mutex> lock(d->mutex);
 		d->exception = std::make_shared<WrappedException>(exception);
 		d->state = Private::BaseFutureData::Exception;
 	}
+	d->flushToWatchers();
 	report(&BaseFutureWatcher::exception);
 
-	if (d->delegateTo) {
-		d->delegateTo->reportException(exception);
+	// only completes once the delegate itself reports the exception
+	if (const std::shared_ptr<BasePromise> delegate = std::atomic_load(&d->delegateTo)) {
+		delegate->propagateException(exception);
+	}
+}
+
+void BasePromise::lendSlot(const std::shared_ptr<BaseFutureData> &other)
+{
+	// we are blocked until other has finished anyway, so it might as well use our slot
+	if (d->holdsSlot && other->resource != Resource::Cpu && other->resource == d->resource) {
+		std::lock_guard<std::mutex> lock(other->mutex);
+		other->slotLent = true;
+	}
+}
+
+std::int64_t BasePromise::traceAwaitBegin(const std::shared_ptr<BaseFutureData> &other)
+{
+	// the arrow ends where the awaited task starts running, possibly on a different thread
+	Trace::flowStart(other->ensureTraceId());
+	return Trace::now();
+}
+void BasePromise::traceAwaitEnd(const std::shared_ptr<BaseFutureData> &other, const std::int64_t start)
+{
+	QJsonObject args;
+	args.insert("task", qint64(d->ensureTraceId()));
+	args.insert("awaited", qint64(other->ensureTraceId()));
+	Trace::complete("await", start, Trace::now() - start, args);
+}
+void BasePromise::traceCompleted(const QString &result)
+{
+	// futures that are only ever fulfilled from elsewhere (whenAll etc.) never start
+	if (d->traceStartedAt < 0) {
+		return;
+	}
+	QString name;
+	{
+		std::lock_guard<std::mutex> lock(d->statusMutex);
+		name = d->traceName.isEmpty() ? QStringLiteral("task") : d->traceName;
+	}
+	QJsonObject args;
+	args.insert("task", qint64(d->ensureTraceId()));
+	if (const std::shared_ptr<BasePromise> delegate = std::atomic_load(&d->delegateTo)) {
+		args.insert("parent", qint64(delegate->d->ensureTraceId()));
+	}
+	if (d->traceScheduledAt >= 0) {
+		args.insert("queued_us", qint64(d->traceStartedAt - d->traceScheduledAt));
 	}
+	args.insert("result", result);
+	Trace::complete(name, d->traceStartedAt, Trace::now() - d->traceStartedAt, args);
 }
 
 }
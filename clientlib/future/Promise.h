@@ -33,9 +33,14 @@ public:
 	virtual ~BasePromise();
 
 	template <typename T>
-	void addTask(const std::shared_ptr<T> &task) { d->tasks.insert(task); }
+	void addTask(const std::shared_ptr<T> &task)
+	{
+		std::unique_lock<std::mutex> lock(d->mutex);
+		d->tasks.push_back(task);
+	}
 
 	void prime(std::future<void> &&future);
+	void prime(const std::launch policy, std::function<void()> &&job);
 	void reportStarted();
 	void reportFinished();
 	void reportCanceled();
@@ -45,6 +50,11 @@ public:
 	// in Future.h
 	template <typename OtherT>
 	OtherT await(const Future<OtherT> &other);
+	/// Like await, status, progress and cancelation are forwarded between us and other, but without waiting
+	template <typename OtherT>
+	void adopt(const Future<OtherT> &other);
+
+	bool isCancelRequested() const { return d->isCancelRequested(); }
 
 protected:
 	template <typename T> std::shared_ptr<Private::FutureData<T>> d_func() const { return std::static_pointer_cast<Private::FutureData<T>>(d); }
@@ -53,6 +63,18 @@ protected:
 
 	template <typename Func, typename... Args>
 	void report(Func &&func, Args&&... args);
+
+private:
+	void propagateException(const std::exception_ptr &exception);
+	// called by await, if we hold a slot of the resource class of other it runs on that one
+	void lendSlot(const std::shared_ptr<Private::BaseFutureData> &other);
+	// reportStatus without tracing, which only the task that reported the status should do
+	void forwardStatus(const QString &message);
+
+	// only called while tracing is enabled (see Trace)
+	std::int64_t traceAwaitBegin(const std::shared_ptr<Private::BaseFutureData> &other);
+	void traceAwaitEnd(const std::shared_ptr<Private::BaseFutureData> &other, const std::int64_t start);
+	void traceCompleted(const QString &result);
 };
 }
 
@@ -63,6 +85,7 @@ class Promise : public Private::BasePromise
 {
 public:
 	explicit Promise() : Private::BasePromise(std::make_shared<Private::FutureData<T>>()) {}
+	explicit Promise(const std::shared_ptr<Private::FutureData<T>> &data) : Private::BasePromise(data) {}
 	Promise(const Promise<T> &other) : Private::BasePromise(other.d) {}
 
 	void reportResult(T &&result)
@@ -79,6 +102,7 @@ class Promise<void> : public Private::BasePromise
 {
 public:
 	explicit Promise() : Private::BasePromise(std::make_shared<Private::FutureData<void>>()) {}
+	explicit Promise(const std::shared_ptr<Private::FutureData<void>> &data) : Private::BasePromise(data) {}
 	Promise(const Promise<void> &other) : Private::BasePromise(other.d) {}
 
 	// in Future.h
@@ -86,5 +110,25 @@ public:
 };
 QT_WARNING_POP
 
+namespace Private {
+template <typename T, typename Func>
+inline void fulfilWith(Promise<T> &promise, Func &&func) { promise.reportResult(func()); }
+template <typename Func>
+inline void fulfilWith(Promise<void> &, Func &&func) { func(); }
+
+/// Runs func and reports its result or exception to promise
+template <typename T, typename Func>
+void fulfil(Promise<T> &promise, Func &&func)
+{
+	try {
+		promise.reportStarted();
+		fulfilWith(promise, std::forward<Func>(func));
+		promise.reportFinished();
+	} catch (...) {
+		promise.reportException(std::current_exception());
+	}
+}
+}
+
 }
 }
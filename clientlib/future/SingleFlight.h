@@ -0,0 +1,108 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QString>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "Future.h"
+
+namespace Ralph {
+namespace ClientLib {
+
+/**
+ * Deduplicates identical operations that are in flight at the same time.
+ *
+ * All callers asking for the same key while the first one has not finished yet share the same
+ * operation, and with that the same result. Every caller gets its own future though, so canceling
+ * one only cancels it for that caller, the operation itself is only canceled once all of them are.
+ * Results are not kept around afterwards, the next call after that starts the operation again.
+ */
+template <typename T>
+class SingleFlight
+{
+public:
+	/// Joins an in-flight operation with the same key, or starts a new one by calling func
+	template <typename Func>
+	Future<T> run(const QString &key, Func &&func)
+	{
+		Promise<T> promise;
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+		const auto it = m_state->inFlight.find(key);
+		// once everybody has given up on it the old one is about to fail, so don't join that
+		if (it == m_state->inFlight.end() || it->second.future.isCancelRequested()) {
+			const std::uint64_t id = ++m_state->nextId;
+			Future<T> future = func();
+			if (it != m_state->inFlight.end()) {
+				m_state->inFlight.erase(it);
+			}
+			m_state->inFlight.emplace(key, Entry{future, id});
+			future.share(promise);
+			lock.unlock();
+
+			// callers coming in before this has run join the finished operation, which is just as good
+			std::shared_ptr<State> state = m_state;
+			future.addContinuation([state, key, id]()
+			{
+				std::lock_guard<std::mutex> guard(state->mutex);
+				const auto entry = state->inFlight.find(key);
+				if (entry != state->inFlight.end() && entry->second.id == id) {
+					state->inFlight.erase(entry);
+				}
+			});
+			settle(future, promise);
+		} else {
+			Future<T> future = it->second.future;
+			future.share(promise);
+			lock.unlock();
+			settle(future, promise);
+		}
+		return promise.future();
+	}
+
+private:
+	struct Entry
+	{
+		Future<T> future;
+		std::uint64_t id;
+	};
+	struct State
+	{
+		std::mutex mutex;
+		std::map<QString, Entry> inFlight;
+		std::uint64_t nextId = 0;
+	};
+	// shared with the continuations, which might still run after we are gone
+	std::shared_ptr<State> m_state = std::make_shared<State>();
+
+	static void settle(Future<T> future, Promise<T> promise)
+	{
+		future.addContinuation([future, promise]() mutable
+		{
+			if (promise.isCancelRequested()) {
+				promise.reportCanceled();
+			} else {
+				Private::fulfil(promise, [&future]() { return future.result(); });
+			}
+		});
+	}
+};
+
+}
+}
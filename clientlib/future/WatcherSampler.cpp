@@ -0,0 +1,79 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WatcherSampler_p.h"
+
+#include <algorithm>
+
+#include "FutureData_p.h"
+
+namespace Ralph {
+namespace ClientLib {
+namespace Private {
+
+constexpr std::chrono::milliseconds WatcherSampler::interval;
+
+WatcherSampler *WatcherSampler::instance()
+{
+	// intentionally leaked, like the Executor
+	static WatcherSampler *sampler = new WatcherSampler;
+	return sampler;
+}
+
+WatcherSampler::WatcherSampler()
+	: m_thread([this]() { run(); })
+{
+	m_thread.detach();
+}
+
+void WatcherSampler::add(const std::shared_ptr<BaseFutureData> &data)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_futures.push_back(data);
+	}
+	m_condition.notify_one();
+}
+void WatcherSampler::remove(const BaseFutureData *data)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_futures.erase(std::remove_if(m_futures.begin(), m_futures.end(), [data](const std::weak_ptr<BaseFutureData> &future)
+	{
+		const std::shared_ptr<BaseFutureData> locked = future.lock();
+		return !locked || locked.get() == data;
+	}), m_futures.end());
+}
+
+void WatcherSampler::run()
+{
+	while (true) {
+		std::vector<std::weak_ptr<BaseFutureData>> futures;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return !m_futures.empty(); });
+			futures = m_futures;
+		}
+		for (const std::weak_ptr<BaseFutureData> &future : futures) {
+			if (const std::shared_ptr<BaseFutureData> data = future.lock()) {
+				data->flushToWatchers();
+			}
+		}
+		std::this_thread::sleep_for(interval);
+	}
+}
+
+}
+}
+}
@@ -0,0 +1,59 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Ralph {
+namespace ClientLib {
+namespace Private {
+class BaseFutureData;
+
+/**
+ * Periodically forwards status and progress of watched futures to their watchers.
+ *
+ * Reporting progress only updates a few atomics, the signals are emitted from the sampler thread
+ * instead, so threads doing the actual work never render anything or wait for whoever is watching.
+ */
+class WatcherSampler
+{
+public:
+	static constexpr std::chrono::milliseconds interval{50};
+
+	static WatcherSampler *instance();
+
+	void add(const std::shared_ptr<BaseFutureData> &data);
+	void remove(const BaseFutureData *data);
+
+private:
+	explicit WatcherSampler();
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<std::weak_ptr<BaseFutureData>> m_futures;
+	std::thread m_thread;
+
+	void run();
+};
+
+}
+}
+}
@@ -16,9 +16,13 @@
 #include "GitRepo.h"
 
 #include <QUrl>
+#include <QLockFile>
 
 #include <git2.h>
 
+#include "future/SingleFlight.h"
+#include "task/LockFile.h"
+
 namespace Ralph {
 namespace ClientLib {
 namespace Git {
@@ -100,39 +104,57 @@ static int gitFetchNotifier(const git_transfer_progress *stats, void *payload)
 	}
 	pl->notifier.progress(stats->received_objects, stats->total_objects);
 
-	return 0;
+	return pl->notifier.isCanceled() ? GIT_EUSER : 0;
 }
 
 Future<GitRepo *> GitRepo::clone(const QDir &dir, const QUrl &url)
 {
-	return async([dir, url](Notifier notifier)
+	// concurrent clones of the same repository into the same place are shared, but everybody gets their own handle
+	static SingleFlight<void> clones;
+	return clones.run(url.toString() + '\n' + dir.absolutePath(), [dir, url]()
 	{
-		initGit();
-
-		notifier.status("Cloning %1..." % url.toString());
-
-		std::unique_ptr<GitRepo> repo = std::make_unique<GitRepo>(dir);
-
-		GitPayload payload{notifier};
-
-		git_clone_options opts = GIT_CLONE_OPTIONS_INIT;
-		opts.checkout_opts.checkout_strategy = GIT_CHECKOUT_FORCE | GIT_CHECKOUT_USE_THEIRS;
-		opts.checkout_opts.progress_cb = &gitCheckoutNotifier;
-		opts.checkout_opts.progress_payload = &payload;
-		opts.fetch_opts.callbacks.transfer_progress = &gitFetchNotifier;
-		opts.fetch_opts.callbacks.payload = &payload;
-		opts.fetch_opts.callbacks.credentials = &credentialsCallback;
-
-		repo->m_repo = GitResource<git_repository>::create(&git_clone, &git_repository_free,
-														   url.toString().toLocal8Bit(), dir.absolutePath().toLocal8Bit(), &opts);
-
-		return repo.release();
-	});
+		// other ralph processes might be cloning into the same place
+		return acquireLock(dir.absolutePath() + ".lock", "Waiting for another process cloning into %1..." % dir.absolutePath())
+				.then([dir, url](const std::shared_ptr<QLockFile> &lock)
+		{
+			// which might have finished by now
+			if (dir.exists(".git")) {
+				lock->unlock();
+				return makeReadyFuture();
+			}
+
+			return async(Resource::Network, [dir, url, lock](Notifier notifier)
+			{
+				initGit();
+
+				notifier.status("Cloning %1..." % url.toString());
+
+				GitPayload payload{notifier};
+
+				git_clone_options opts = GIT_CLONE_OPTIONS_INIT;
+				opts.checkout_opts.checkout_strategy = GIT_CHECKOUT_FORCE | GIT_CHECKOUT_USE_THEIRS;
+				opts.checkout_opts.progress_cb = &gitCheckoutNotifier;
+				opts.checkout_opts.progress_payload = &payload;
+				opts.fetch_opts.callbacks.transfer_progress = &gitFetchNotifier;
+				opts.fetch_opts.callbacks.payload = &payload;
+				opts.fetch_opts.callbacks.credentials = &credentialsCallback;
+
+				try {
+					GitResource<git_repository>::create(&git_clone, &git_repository_free,
+														url.toString().toLocal8Bit(), dir.absolutePath().toLocal8Bit(), &opts);
+				} catch (...) {
+					lock->unlock();
+					throw;
+				}
+				lock->unlock();
+			});
+		});
+	}).then([dir]() { return open(dir); });
 }
 
 Future<void> GitRepo::fetch() const
 {
-	return async([this](Notifier notifier)
+	return async(Resource::Network, [this](Notifier notifier)
 	{
 		auto remote = GitResource<git_remote>::create(&git_remote_lookup, &git_remote_free, m_repo, "origin");
 
@@ -148,7 +170,7 @@ Future<void> GitRepo::fetch() const
 }
 Future<void> GitRepo::checkout(const QString &id) const
 {
-	return async([this, id](Notifier notifier)
+	return async(Resource::Disk, [this, id](Notifier notifier)
 	{
 		auto treeish = GitResource<git_object>::create(&git_revparse_single, &git_object_free, m_repo, id.toLocal8Bit().constData());
 
@@ -163,16 +185,15 @@ Future<void> GitRepo::checkout(const QString &id) const
 }
 Future<void> GitRepo::pull(const QString &id) const
 {
-	return async([this, id](Notifier notifier)
-	{
-		notifier.await(fetch());
-		notifier.await(checkout(id));
-	});
+	return fetch().then([this, id]() { return checkout(id); });
 }
 
 static int gitSubmoduleUpdate(git_submodule *sm, const char *, void *payload)
 {
 	GitPayload *pl = static_cast<GitPayload *>(payload);
+	if (pl->notifier.isCanceled()) {
+		return GIT_EUSER;
+	}
 
 	git_submodule_update_options opts = GIT_SUBMODULE_UPDATE_OPTIONS_INIT;
 	opts.checkout_opts.checkout_strategy = GIT_CHECKOUT_FORCE | GIT_CHECKOUT_USE_THEIRS;
@@ -186,13 +207,45 @@ static int gitSubmoduleUpdate(git_submodule *sm, const char *, void *payload)
 }
 Future<void> GitRepo::submodulesUpdate(const bool init) const
 {
-	return async([this, init](Notifier notifier)
+	return async(Resource::Network, [this, init](Notifier notifier)
 	{
 		GitPayload payload{notifier, QString(), init};
 		GitException::checkAndThrow(git_submodule_foreach(m_repo, &gitSubmoduleUpdate, &payload));
 	});
 }
 
+QString GitRepo::head() const
+{
+	git_oid oid;
+	GitException::checkAndThrow(git_reference_name_to_id(&oid, m_repo, "HEAD"));
+	char buffer[GIT_OID_HEXSZ + 1];
+	git_oid_tostr(buffer, sizeof(buffer), &oid);
+	return QString::fromLatin1(buffer);
+}
+QVector<QString> GitRepo::changedFiles(const QString &from, const QString &to) const
+{
+	auto treeOf = [this](const QString &revision)
+	{
+		return GitResource<git_object>::create(&git_revparse_single, &git_object_free, m_repo, (revision + "^{tree}").toLocal8Bit().constData());
+	};
+	const GitResource<git_object> fromTree = treeOf(from);
+	const GitResource<git_object> toTree = treeOf(to);
+	// only compares the trees, which does not need to look at the contents of unchanged directories
+	auto diff = GitResource<git_diff>::create(&git_diff_tree_to_tree, &git_diff_free, m_repo,
+											  reinterpret_cast<git_tree *>(fromTree.get()), reinterpret_cast<git_tree *>(toTree.get()), nullptr);
+
+	QVector<QString> files;
+	for (std::size_t i = 0; i < git_diff_num_deltas(diff); ++i) {
+		const git_diff_delta *delta = git_diff_get_delta(diff, i);
+		files.append(QString::fromUtf8(delta->old_file.path));
+		// only differs for renames
+		if (qstrcmp(delta->old_file.path, delta->new_file.path) != 0) {
+			files.append(QString::fromUtf8(delta->new_file.path));
+		}
+	}
+	return files;
+}
+
 GitCredentialResponse::GitCredentialResponse(git_cred *cred)
 	: m_cred(cred) {}
 GitCredentialResponse GitCredentialResponse::createForUsername(const QString &username)
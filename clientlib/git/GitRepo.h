@@ -125,6 +125,11 @@ public:
 	Future<void> pull(const QString &id) const;
 	Future<void> submodulesUpdate(const bool init = true) const;
 
+	/// Id of the commit HEAD points to
+	QString head() const;
+	/// Paths (relative to dir()) of all files that differ between the trees of two revisions
+	QVector<QString> changedFiles(const QString &from, const QString &to) const;
+
 	template <typename Func>
 	static void setCredentialsCallback(Func &&func)
 	{
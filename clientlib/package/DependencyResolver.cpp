@@ -0,0 +1,636 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DependencyResolver.h"
+
+#include <QBitArray>
+#include <QSet>
+#include <QStringList>
+#include <algorithm>
+#include <functional>
+
+#include "Package.h"
+#include "PackageDatabase.h"
+
+namespace Ralph {
+namespace ClientLib {
+
+namespace {
+// a set of versions of a package, by index into its candidates. positive terms require the package to
+// be selected, negative ones are also satisfied if it is not selected at all.
+struct Term
+{
+	int package;
+	QBitArray versions;
+	bool positive;
+
+	static bool isEmpty(const QBitArray &bits) { return bits.count(true) == 0; }
+
+	Term intersect(const Term &other) const { return Term{package, versions & other.versions, positive || other.positive}; }
+	Term negate() const { return Term{package, ~versions, !positive}; }
+	bool isEmpty() const { return positive && isEmpty(versions); }
+	bool isSubsetOf(const Term &other) const { return isEmpty(versions & ~other.versions) && (positive || !other.positive); }
+	bool isDisjointFrom(const Term &other) const { return intersect(other).isEmpty(); }
+};
+
+// the terms can not all be true at the same time
+struct Incompatibility
+{
+	enum Cause
+	{
+		Root, ///< The root has to be selected
+		Dependency, ///< terms.first() depends on terms.last(), see requirement
+		Conflict ///< Derived from left and right
+	} cause;
+	QVector<Term> terms;
+	QString requirement;
+	int left;
+	int right;
+};
+
+struct Assignment
+{
+	Term term;
+	int level;
+	int cause; ///< The incompatibility it was derived from, -1 for decisions
+};
+
+struct Candidate
+{
+	QString name;
+	/// Ascending, without duplicates
+	QVector<const Package *> versions;
+	int preferred;
+	/// Non-optional dependencies of each version, read when first needed
+	QVector<QVector<PackageDependency>> dependencies;
+	QBitArray dependenciesRead;
+};
+
+class Solver
+{
+public:
+	explicit Solver(const PackageDatabase *db, const QHash<QString, Version> &preferred)
+		: m_db(db), m_preferred(preferred) {}
+
+	DependencyResolver::Resolution solve(const Package *root)
+	{
+		m_packages.append(Candidate{root->name(), {root}, 0, QVector<QVector<PackageDependency>>(1), QBitArray(1)});
+		growState();
+		addIncompatibility(Incompatibility{Incompatibility::Root, {Term{0, QBitArray(1), false}}, QString(), -1, -1}, true);
+
+		int next = 0;
+		while (next >= 0) {
+			propagate(next);
+			next = decide();
+		}
+		return resolution();
+	}
+
+private:
+	enum Relation
+	{
+		Satisfied,
+		AlmostSatisfied, ///< All terms but one are satisfied, and that one is inconclusive
+		Contradicted,
+		Inconclusive
+	};
+
+	const PackageDatabase *m_db;
+	const QHash<QString, Version> m_preferred;
+
+	// index 0 is the root
+	QVector<Candidate> m_packages;
+	QHash<QString, int> m_ids;
+
+	QVector<Incompatibility> m_incompatibilities;
+	// only the ones used for propagation, derived ones that were skipped during conflict resolution are not in here
+	QVector<QVector<int>> m_byPackage;
+
+	// the partial solution
+	QVector<Assignment> m_assignments;
+	QVector<Term> m_accumulated; ///< Intersection of all assignments of each package, see m_assigned
+	QVector<bool> m_assigned;
+	QVector<int> m_decided; ///< Index of the decided version, or -1
+	int m_level = 0;
+
+	int packageId(const QString &name)
+	{
+		const QString key = name.toLower();
+		const auto it = m_ids.constFind(key);
+		if (it != m_ids.constEnd()) {
+			return it.value();
+		}
+
+		Candidate candidate{name, {}, -1, {}, QBitArray()};
+		// equal versions from different databases are in order of precedence, the first one wins
+		for (const Package *pkg : m_db->findPackages(key)) {
+			if (candidate.versions.isEmpty() || candidate.versions.last()->version() != pkg->version()) {
+				candidate.versions.append(pkg);
+			}
+		}
+		const Version preferred = m_preferred.value(key);
+		for (int i = 0; preferred.isValid() && i < candidate.versions.size(); ++i) {
+			if (candidate.versions.at(i)->version() == preferred) {
+				candidate.preferred = i;
+			}
+		}
+		candidate.dependencies.resize(candidate.versions.size());
+		candidate.dependenciesRead = QBitArray(candidate.versions.size());
+
+		m_packages.append(candidate);
+		m_ids.insert(key, m_packages.size() - 1);
+		growState();
+		return m_packages.size() - 1;
+	}
+	void growState()
+	{
+		const int package = m_packages.size() - 1;
+		m_byPackage.append(QVector<int>());
+		m_accumulated.append(universe(package));
+		m_assigned.append(false);
+		m_decided.append(-1);
+	}
+
+	Term universe(const int package) const { return Term{package, QBitArray(m_packages.at(package).versions.size(), true), false}; }
+	Term single(const int package, const int version) const
+	{
+		QBitArray bits(m_packages.at(package).versions.size());
+		bits.setBit(version);
+		return Term{package, bits, true};
+	}
+
+	QVector<PackageDependency> dependencies(const int package, const int version)
+	{
+		Candidate &candidate = m_packages[package];
+		if (!candidate.dependenciesRead.testBit(version)) {
+			for (const PackageDependency &dependency : candidate.versions.at(version)->dependencies()) {
+				if (!dependency.isOptional()) {
+					candidate.dependencies[version].append(dependency);
+				}
+			}
+			candidate.dependenciesRead.setBit(version);
+		}
+		return candidate.dependencies.at(version);
+	}
+	bool hasDependency(const int package, const int version, const QString &name, const QString &requirement)
+	{
+		for (const PackageDependency &dependency : dependencies(package, version)) {
+			if (dependency.package().compare(name, Qt::CaseInsensitive) == 0 && dependency.version().toString() == requirement) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// merges terms of the same package, and drops the root (which is always selected anyway) and terms that are always true
+	QVector<Term> normalized(const QVector<Term> &terms) const
+	{
+		QVector<Term> out;
+		for (const Term &term : terms) {
+			auto it = std::find_if(out.begin(), out.end(), [term](const Term &existing) { return existing.package == term.package; });
+			if (it == out.end()) {
+				out.append(term);
+			} else {
+				*it = it->intersect(term);
+			}
+		}
+		out.erase(std::remove_if(out.begin(), out.end(), [this](const Term &term) { return universe(term.package).isSubsetOf(term); }), out.end());
+		if (out.size() > 1) {
+			out.erase(std::remove_if(out.begin(), out.end(), [](const Term &term) { return term.package == 0 && term.positive; }), out.end());
+		}
+		return out;
+	}
+	int addIncompatibility(const Incompatibility &incompatibility, const bool forPropagation)
+	{
+		m_incompatibilities.append(incompatibility);
+		const int id = m_incompatibilities.size() - 1;
+		if (forPropagation) {
+			for (const Term &term : incompatibility.terms) {
+				m_byPackage[term.package].append(id);
+			}
+		}
+		return id;
+	}
+
+	Relation relation(const Term &term) const
+	{
+		const Term &current = m_accumulated.at(term.package);
+		if (current.isSubsetOf(term)) {
+			return Satisfied;
+		} else if (current.isDisjointFrom(term)) {
+			return Contradicted;
+		}
+		return Inconclusive;
+	}
+	Relation relation(const int incompatibility, int *unsatisfied) const
+	{
+		Relation result = Satisfied;
+		const QVector<Term> &terms = m_incompatibilities.at(incompatibility).terms;
+		for (int i = 0; i < terms.size(); ++i) {
+			switch (relation(terms.at(i))) {
+			case Satisfied:
+				break;
+			case Contradicted:
+				return Contradicted;
+			default:
+				if (result == AlmostSatisfied) {
+					return Inconclusive;
+				}
+				result = AlmostSatisfied;
+				*unsatisfied = i;
+			}
+		}
+		return result;
+	}
+
+	void assign(const Assignment &assignment)
+	{
+		const int package = assignment.term.package;
+		m_assignments.append(assignment);
+		m_accumulated[package] = m_accumulated.at(package).intersect(assignment.term);
+		m_assigned[package] = true;
+		if (assignment.cause < 0) {
+			// decisions are always a single version
+			for (int i = 0; i < assignment.term.versions.size(); ++i) {
+				if (assignment.term.versions.testBit(i)) {
+					m_decided[package] = i;
+				}
+			}
+		}
+	}
+	void backtrack(const int level)
+	{
+		while (!m_assignments.isEmpty() && m_assignments.last().level > level) {
+			m_assignments.removeLast();
+		}
+		m_level = level;
+		for (int package = 0; package < m_packages.size(); ++package) {
+			m_accumulated[package] = universe(package);
+			m_assigned[package] = false;
+			m_decided[package] = -1;
+		}
+		const QVector<Assignment> remaining = m_assignments;
+		m_assignments.clear();
+		for (const Assignment &assignment : remaining) {
+			assign(assignment);
+		}
+	}
+
+	void propagate(const int package)
+	{
+		QVector<int> changed{package};
+		while (!changed.isEmpty()) {
+			const int current = changed.takeLast();
+			// most recently added ones first, they are the most likely to be relevant
+			const QVector<int> incompatibilities = m_byPackage.at(current);
+			for (int i = incompatibilities.size() - 1; i >= 0; --i) {
+				int incompatibility = incompatibilities.at(i);
+				int unsatisfied = -1;
+				const Relation rel = relation(incompatibility, &unsatisfied);
+				if (rel == Satisfied) {
+					incompatibility = resolveConflict(incompatibility);
+					// after jumping back it is almost satisfied, so we can derive something from it
+					relation(incompatibility, &unsatisfied);
+					const Term term = m_incompatibilities.at(incompatibility).terms.at(unsatisfied);
+					assign(Assignment{term.negate(), m_level, incompatibility});
+					changed = {term.package};
+					break;
+				} else if (rel == AlmostSatisfied) {
+					const Term term = m_incompatibilities.at(incompatibility).terms.at(unsatisfied);
+					assign(Assignment{term.negate(), m_level, incompatibility});
+					if (!changed.contains(term.package)) {
+						changed.append(term.package);
+					}
+				}
+			}
+		}
+	}
+
+	// the first assignment with which the partial solution satisfies term, optionally also taking with into account.
+	// -1 if term is satisfied even without any assignments.
+	int satisfier(const Term &term, const int before, const Term *with = nullptr) const
+	{
+		Term accumulated = universe(term.package);
+		if ((with ? accumulated.intersect(*with) : accumulated).isSubsetOf(term)) {
+			return -1;
+		}
+		for (int i = 0; i < before; ++i) {
+			const Assignment &assignment = m_assignments.at(i);
+			if (assignment.term.package != term.package) {
+				continue;
+			}
+			accumulated = accumulated.intersect(assignment.term);
+			if ((with ? accumulated.intersect(*with) : accumulated).isSubsetOf(term)) {
+				return i;
+			}
+		}
+		return -1;
+	}
+	int resolveConflict(const int conflict)
+	{
+		int incompatibility = conflict;
+		while (true) {
+			const Incompatibility current = m_incompatibilities.at(incompatibility);
+
+			// the assignment that made the incompatibility satisfied, and the one before it that would do the same
+			int satisfierIndex = -1;
+			int termIndex = -1;
+			QVector<int> satisfiers;
+			for (int i = 0; i < current.terms.size(); ++i) {
+				satisfiers.append(satisfier(current.terms.at(i), m_assignments.size()));
+				if (satisfiers.last() > satisfierIndex) {
+					satisfierIndex = satisfiers.last();
+					termIndex = i;
+				}
+			}
+			// satisfied no matter what we decide, or only by selecting the root
+			if (satisfierIndex < 0 || (current.terms.size() == 1 && current.terms.first().package == 0 && current.terms.first().positive)) {
+				throw DependencyResolverException(QString("Unable to resolve the dependencies of %1:\n%2").arg(m_packages.first().name, explain(incompatibility)));
+			}
+			const Assignment found = m_assignments.at(satisfierIndex);
+			const Term term = current.terms.at(termIndex);
+			int previous = -1;
+			for (int i = 0; i < satisfiers.size(); ++i) {
+				if (i != termIndex) {
+					previous = std::max(previous, satisfiers.at(i));
+				}
+			}
+			if (!found.term.isSubsetOf(term)) {
+				previous = std::max(previous, satisfier(term, satisfierIndex, &found.term));
+			}
+			// the root is decided at level 1, and stays decided
+			const int previousLevel = std::max(previous >= 0 ? m_assignments.at(previous).level : 1, 1);
+
+			if (found.cause < 0 || previousLevel < found.level) {
+				if (incompatibility != conflict) {
+					for (const Term &learned : current.terms) {
+						m_byPackage[learned.package].append(incompatibility);
+					}
+				}
+				backtrack(previousLevel);
+				return incompatibility;
+			}
+
+			// combine with what the satisfier was derived from, which replaces it by something earlier
+			QVector<Term> terms;
+			for (int i = 0; i < current.terms.size(); ++i) {
+				if (i != termIndex) {
+					terms.append(current.terms.at(i));
+				}
+			}
+			for (const Term &other : m_incompatibilities.at(found.cause).terms) {
+				if (other.package != found.term.package) {
+					terms.append(other);
+				}
+			}
+			if (!found.term.isSubsetOf(term)) {
+				terms.append(found.term.intersect(term.negate()).negate());
+			}
+			incompatibility = addIncompatibility(Incompatibility{Incompatibility::Conflict, normalized(terms), QString(), incompatibility, found.cause}, false);
+		}
+	}
+
+	int decide()
+	{
+		// packages with the fewest candidates left first, they are the most likely to conflict
+		int package = -1;
+		int remaining = 0;
+		for (int i = 0; i < m_packages.size(); ++i) {
+			if (m_assigned.at(i) && m_accumulated.at(i).positive && m_decided.at(i) < 0) {
+				const int count = m_accumulated.at(i).versions.count(true);
+				if (package < 0 || count < remaining) {
+					package = i;
+					remaining = count;
+				}
+			}
+		}
+		if (package < 0) {
+			return -1;
+		}
+
+		const QBitArray allowed = m_accumulated.at(package).versions;
+		int version = m_packages.at(package).preferred;
+		if (version < 0 || !allowed.testBit(version)) {
+			version = allowed.size() - 1;
+			while (!allowed.testBit(version)) {
+				--version;
+			}
+		}
+
+		// if a dependency already conflicts with the partial solution, propagation will rule this version out instead
+		bool conflicts = false;
+		for (const int incompatibility : dependencyIncompatibilities(package, version)) {
+			bool othersSatisfied = true;
+			for (const Term &term : m_incompatibilities.at(incompatibility).terms) {
+				if (term.package != package && relation(term) != Satisfied) {
+					othersSatisfied = false;
+				}
+			}
+			conflicts = conflicts || othersSatisfied;
+		}
+		if (!conflicts) {
+			++m_level;
+			assign(Assignment{single(package, version), m_level, -1});
+		}
+		return package;
+	}
+	// "package version depends on dependency", extended to all neighbouring versions with the same dependency
+	QVector<int> dependencyIncompatibilities(const int package, const int version)
+	{
+		QVector<int> out;
+		for (const PackageDependency &dependency : dependencies(package, version)) {
+			const int target = packageId(dependency.package());
+			const QString requirement = dependency.version().toString();
+
+			const auto existing = std::find_if(m_byPackage.at(package).cbegin(), m_byPackage.at(package).cend(), [this, package, version, target, requirement](const int id)
+			{
+				const Incompatibility &incompatibility = m_incompatibilities.at(id);
+				return incompatibility.cause == Incompatibility::Dependency && incompatibility.terms.first().package == package
+						&& incompatibility.terms.first().versions.testBit(version) && incompatibility.terms.last().package == target
+						&& incompatibility.requirement == requirement;
+			});
+			if (existing != m_byPackage.at(package).cend()) {
+				out.append(*existing);
+				continue;
+			}
+
+			QBitArray versions(m_packages.at(package).versions.size());
+			versions.setBit(version);
+			for (int i = version - 1; i >= 0 && hasDependency(package, i, dependency.package(), requirement); --i) {
+				versions.setBit(i);
+			}
+			for (int i = version + 1; i < versions.size() && hasDependency(package, i, dependency.package(), requirement); ++i) {
+				versions.setBit(i);
+			}
+
+			const QVector<const Package *> &candidates = m_packages.at(target).versions;
+			QBitArray accepted(candidates.size());
+			for (int i = 0; i < candidates.size(); ++i) {
+				accepted.setBit(i, !dependency.version().isValid() || dependency.version().accepts(candidates.at(i)->version()));
+			}
+			out.append(addIncompatibility(Incompatibility{Incompatibility::Dependency, {Term{package, versions, true}, Term{target, ~accepted, false}},
+														  requirement, -1, -1}, true));
+		}
+		return out;
+	}
+
+	DependencyResolver::Resolution resolution()
+	{
+		DependencyResolver::Resolution out;
+		QSet<int> visited;
+		// depth first, so that dependencies end up before their dependents
+		std::function<void(int)> visit = [this, &out, &visited, &visit](const int package)
+		{
+			visited.insert(package);
+			QVector<const Package *> direct;
+			for (const PackageDependency &dependency : dependencies(package, m_decided.at(package))) {
+				const int target = m_ids.value(dependency.package().toLower());
+				if (!visited.contains(target)) {
+					visit(target);
+				}
+				direct.append(m_packages.at(target).versions.at(m_decided.at(target)));
+			}
+			if (package != 0) {
+				const Package *pkg = m_packages.at(package).versions.at(m_decided.at(package));
+				out.packages.append(pkg);
+				out.dependencies.insert(pkg, direct);
+			}
+		};
+		visit(0);
+		return out;
+	}
+
+	// explanations, roughly like pub does them
+	QString describe(const Term &term) const
+	{
+		const Candidate &candidate = m_packages.at(term.package);
+		const QBitArray &bits = term.positive ? term.versions : ~term.versions;
+		if (term.package == 0) {
+			return candidate.name;
+		}
+		QVector<int> set;
+		for (int i = 0; i < bits.size(); ++i) {
+			if (bits.testBit(i)) {
+				set.append(i);
+			}
+		}
+		auto versionString = [&candidate](const int index) { return candidate.versions.at(index)->version().toString(); };
+		if (set.size() == bits.size()) {
+			return candidate.name;
+		} else if (set.isEmpty()) {
+			return QString("%1 (no version)").arg(candidate.name);
+		} else if (set.size() == 1) {
+			return QString("%1 %2").arg(candidate.name, versionString(set.first()));
+		} else if (set.last() - set.first() + 1 == set.size()) {
+			return QString("%1 %2 - %3").arg(candidate.name, versionString(set.first()), versionString(set.last()));
+		} else if (set.size() <= 5) {
+			QStringList versions;
+			for (const int index : set) {
+				versions.append(versionString(index));
+			}
+			return QString("%1 %2").arg(candidate.name, versions.join(", "));
+		} else {
+			return QString("%1 (%2 versions between %3 and %4)").arg(candidate.name, QString::number(set.size()), versionString(set.first()), versionString(set.last()));
+		}
+	}
+	QString describe(const int id) const
+	{
+		const Incompatibility &incompatibility = m_incompatibilities.at(id);
+		const QVector<Term> &terms = incompatibility.terms;
+		if (incompatibility.cause == Incompatibility::Root) {
+			return QString("%1 is being resolved").arg(m_packages.first().name);
+		} else if (incompatibility.cause == Incompatibility::Dependency) {
+			const QString dependency = QString("%1 %2").arg(m_packages.at(terms.last().package).name, incompatibility.requirement).trimmed();
+			const bool exists = !Term::isEmpty(~terms.last().versions);
+			return QString("%1 depends on %2%3").arg(describe(terms.first()), dependency, exists ? QString() : QStringLiteral(" which matches no known version"));
+		}
+
+		QStringList positive;
+		QStringList negative;
+		for (const Term &term : terms) {
+			(term.positive ? positive : negative).append(describe(term));
+		}
+		if (terms.isEmpty() || (terms.size() == 1 && terms.first().package == 0 && terms.first().positive)) {
+			return "version solving failed";
+		} else if (terms.size() == 1) {
+			return terms.first().positive ? QString("%1 is forbidden").arg(positive.first()) : QString("%1 is required").arg(negative.first());
+		} else if (positive.size() == 1 && negative.size() == 1) {
+			return QString("%1 requires %2").arg(positive.first(), negative.first());
+		} else if (negative.isEmpty()) {
+			return QString("%1 are incompatible").arg(positive.join(" and "));
+		} else if (positive.isEmpty()) {
+			return QString("one of %1 is required").arg(negative.join(", "));
+		}
+		return QString("if %1 then %2").arg(positive.join(" and "), negative.join(" or "));
+	}
+	QString explain(const int failure) const
+	{
+		QStringList lines;
+		QHash<int, int> numbers;
+		std::function<void(int)> visit = [this, &lines, &numbers, &visit](const int id)
+		{
+			const Incompatibility &incompatibility = m_incompatibilities.at(id);
+			const int left = incompatibility.left;
+			const int right = incompatibility.right;
+			const bool leftDerived = m_incompatibilities.at(left).cause == Incompatibility::Conflict;
+			const bool rightDerived = m_incompatibilities.at(right).cause == Incompatibility::Conflict;
+			// derived incompatibilities get numbers, so that they can be referred to again later
+			auto reference = [this, &lines, &numbers, &visit](const int derived)
+			{
+				if (!numbers.contains(derived)) {
+					visit(derived);
+					numbers.insert(derived, numbers.size() + 1);
+					lines.last() += QString(" (%1)").arg(numbers.value(derived));
+				}
+				return QString("%1 (%2)").arg(describe(derived), QString::number(numbers.value(derived)));
+			};
+
+			if (leftDerived && rightDerived) {
+				const QString first = reference(left);
+				const QString second = reference(right);
+				lines.append(QString("Because %1 and %2, %3.").arg(first, second, describe(id)));
+			} else if (leftDerived || rightDerived) {
+				const int derived = leftDerived ? left : right;
+				const int external = leftDerived ? right : left;
+				if (numbers.contains(derived)) {
+					lines.append(QString("Because %1 and %2, %3.").arg(describe(external), reference(derived), describe(id)));
+				} else {
+					visit(derived);
+					lines.append(QString("And because %1, %2.").arg(describe(external), describe(id)));
+				}
+			} else {
+				lines.append(QString("Because %1 and %2, %3.").arg(describe(left), describe(right), describe(id)));
+			}
+		};
+
+		if (m_incompatibilities.at(failure).cause != Incompatibility::Conflict) {
+			return describe(failure);
+		}
+		visit(failure);
+		return lines.join('\n');
+	}
+};
+}
+
+DependencyResolver::DependencyResolver(const PackageDatabase *db)
+	: m_db(db) {}
+
+DependencyResolver::Resolution DependencyResolver::resolve(const Package *root) const
+{
+	return Solver(m_db, m_preferred).solve(root);
+}
+
+}
+}
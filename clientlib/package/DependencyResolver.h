@@ -0,0 +1,68 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QVector>
+
+#include "Exception.h"
+#include "Version.h"
+
+namespace Ralph {
+namespace ClientLib {
+class Package;
+class PackageDatabase;
+
+DECLARE_EXCEPTION(DependencyResolver);
+
+/**
+ * Picks a version of every package that a project (transitively) depends on, following PubGrub.
+ *
+ * The candidates of every package are the versions known to the database, so every set of
+ * versions is a bit set over them. Dependencies are turned into incompatibilities ("foo 1.0 - 1.2
+ * and not bar >=2.0 can not both be true"), which are used for unit propagation after every
+ * decision. A conflict is resolved by deriving a new incompatibility from the ones involved and
+ * jumping back to the decision level where it is no longer satisfied, so the same dead end is
+ * never explored twice.
+ *
+ * If there is no solution the derivation of the final incompatibility explains why, step by step.
+ */
+class DependencyResolver
+{
+public:
+	struct Resolution
+	{
+		/// Every package comes after all of its dependencies
+		QVector<const Package *> packages;
+		/// The non-optional dependencies of every package in packages
+		QHash<const Package *, QVector<const Package *>> dependencies;
+	};
+
+	explicit DependencyResolver(const PackageDatabase *db);
+
+	/// Versions to pick whenever they are allowed, like the ones from the lock file. Keys are lowercase.
+	void setPreferred(const QHash<QString, Version> &preferred) { m_preferred = preferred; }
+
+	/// Throws a DependencyResolverException explaining the conflict if there is no solution
+	Resolution resolve(const Package *root) const;
+
+private:
+	const PackageDatabase *m_db;
+	QHash<QString, Version> m_preferred;
+};
+
+}
+}
@@ -0,0 +1,137 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NameSearch.h"
+
+#include <QSet>
+#include <algorithm>
+#include <iterator>
+
+namespace Ralph {
+namespace ClientLib {
+
+bool NameSearch::Match::operator<(const Match &other) const
+{
+	if (kind != other.kind) {
+		return kind < other.kind;
+	}
+	if (score != other.score) {
+		return score < other.score;
+	}
+	return name < other.name;
+}
+
+NameSearch::~NameSearch() {}
+
+QVector<NameSearch::Match> NameSearch::search(const QString &query, const int limit) const
+{
+	const QByteArray needle = query.toLower().toUtf8();
+	QVector<Match> matches;
+	QSet<quint32> matched;
+	auto classify = [this, &needle, &matches, &matched](const quint32 index)
+	{
+		const QByteArray candidate = name(index);
+		const int position = candidate.indexOf(needle);
+		if (position < 0) {
+			return;
+		}
+		matched.insert(index);
+		// shorter names are closer to what was asked for
+		if (candidate.size() == needle.size()) {
+			matches.append(Match{Match::Exact, 0, QString::fromUtf8(candidate)});
+		} else if (position == 0) {
+			matches.append(Match{Match::Prefix, candidate.size(), QString::fromUtf8(candidate)});
+		} else {
+			matches.append(Match{Match::Substring, candidate.size(), QString::fromUtf8(candidate)});
+		}
+	};
+
+	const QVector<quint32> queryTrigrams = trigrams(needle);
+	if (queryTrigrams.isEmpty()) {
+		// too short to have any trigrams, but that also makes almost every name a match anyway
+		for (quint32 i = 0; i < nameCount(); ++i) {
+			classify(i);
+		}
+	} else {
+		QVector<QVector<quint32>> lists;
+		for (const quint32 trigram : queryTrigrams) {
+			lists.append(postings(trigram));
+		}
+		// starting with the shortest list keeps all intermediate results small
+		std::sort(lists.begin(), lists.end(), [](const QVector<quint32> &a, const QVector<quint32> &b) { return a.size() < b.size(); });
+		QVector<quint32> candidates = lists.first();
+		for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+			QVector<quint32> intersection;
+			std::set_intersection(candidates.cbegin(), candidates.cend(), lists.at(i).cbegin(), lists.at(i).cend(), std::back_inserter(intersection));
+			candidates = intersection;
+		}
+		for (const quint32 candidate : candidates) {
+			classify(candidate);
+		}
+
+		// typos and the like, only looked for if there are not enough proper matches
+		if (limit == 0 || matches.size() < limit) {
+			QHash<quint32, int> shared;
+			for (const QVector<quint32> &list : lists) {
+				for (const quint32 index : list) {
+					if (!matched.contains(index)) {
+						++shared[index];
+					}
+				}
+			}
+			const int required = std::max(1, queryTrigrams.size() / 2);
+			for (auto it = shared.cbegin(); it != shared.cend(); ++it) {
+				if (it.value() >= required) {
+					matches.append(Match{Match::Fuzzy, queryTrigrams.size() - it.value(), QString::fromUtf8(name(it.key()))});
+				}
+			}
+		}
+	}
+
+	if (limit > 0 && matches.size() > limit) {
+		std::partial_sort(matches.begin(), matches.begin() + limit, matches.end());
+		matches.resize(limit);
+	} else {
+		std::sort(matches.begin(), matches.end());
+	}
+	return matches;
+}
+
+QVector<quint32> NameSearch::trigrams(const QByteArray &name)
+{
+	QVector<quint32> out;
+	for (int i = 0; i + 3 <= name.size(); ++i) {
+		out.append(quint32(uchar(name.at(i))) << 16 | quint32(uchar(name.at(i + 1))) << 8 | quint32(uchar(name.at(i + 2))));
+	}
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+	return out;
+}
+
+InMemoryNameSearch::InMemoryNameSearch(const QVector<QString> &names)
+{
+	for (const QString &str : names) {
+		const quint32 index = quint32(m_names.size());
+		m_names.append(str.toLower().toUtf8());
+		// indices only ever grow, so the lists stay sorted
+		for (const quint32 trigram : trigrams(m_names.last())) {
+			m_postings[trigram].append(index);
+		}
+	}
+}
+InMemoryNameSearch::~InMemoryNameSearch() {}
+
+}
+}
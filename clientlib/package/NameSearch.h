@@ -0,0 +1,89 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace Ralph {
+namespace ClientLib {
+
+/**
+ * Trigram based search over the (lowercase) package names of a database.
+ *
+ * Every name is split into all its three byte long substrings (of the UTF-8 encoding), and for
+ * every such trigram a sorted list of the names containing it is kept. A name can only contain
+ * the query if it contains all trigrams of the query, so only the intersection of a few short
+ * lists needs to be looked at instead of all names.
+ *
+ * Implementations only provide the names and lists, see PackageIndex for one that reads them
+ * from the mapped index and InMemoryNameSearch for one that builds them on the fly.
+ */
+class NameSearch
+{
+public:
+	struct Match
+	{
+		enum Kind
+		{
+			Exact,
+			Prefix,
+			Substring,
+			Fuzzy
+		} kind;
+		int score; ///< Lower is better, only comparable between matches of the same kind
+		QString name;
+
+		bool operator<(const Match &other) const;
+	};
+
+	virtual ~NameSearch();
+
+	/// Best matches first: exact, prefix, substring, and finally names that share most trigrams with query.
+	/// Returns all matches if limit is 0, all names if query is empty.
+	QVector<Match> search(const QString &query, const int limit) const;
+
+	/// Sorted and without duplicates
+	static QVector<quint32> trigrams(const QByteArray &name);
+
+protected:
+	virtual quint32 nameCount() const = 0;
+	/// UTF-8 encoded, lowercase
+	virtual QByteArray name(const quint32 index) const = 0;
+	/// Sorted indices of all names that contain trigram
+	virtual QVector<quint32> postings(const quint32 trigram) const = 0;
+};
+
+class InMemoryNameSearch : public NameSearch
+{
+public:
+	explicit InMemoryNameSearch(const QVector<QString> &names = {});
+	~InMemoryNameSearch() override;
+
+protected:
+	quint32 nameCount() const override { return quint32(m_names.size()); }
+	QByteArray name(const quint32 index) const override { return m_names.at(int(index)); }
+	QVector<quint32> postings(const quint32 trigram) const override { return m_postings.value(trigram); }
+
+private:
+	QVector<QByteArray> m_names;
+	QHash<quint32, QVector<quint32>> m_postings;
+};
+
+}
+}
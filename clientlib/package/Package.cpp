@@ -15,6 +15,9 @@
 
 #include "Package.h"
 
+#include <QDataStream>
+#include <mutex>
+
 #include "Json.h"
 #include "Functional.h"
 #include "PackageMirror.h"
@@ -25,10 +28,50 @@ using namespace Common;
 
 namespace ClientLib {
 
+struct Package::Lazy
+{
+	std::once_flag once;
+	QByteArray data;
+};
+
 Package::Package() {}
 
 Package::~Package() {}
 
+Package *Package::createLazy(const QByteArray &data)
+{
+	QDataStream str(data);
+	str.setVersion(QDataStream::Qt_5_0);
+	std::unique_ptr<Package> package = std::make_unique<Package>();
+	str >> package->m_name >> package->m_version;
+	if (str.status() != QDataStream::Ok) {
+		return nullptr;
+	}
+	package->m_lazy = std::make_shared<Lazy>();
+	package->m_lazy->data = data;
+	return package.release();
+}
+void Package::loadLazy() const
+{
+	std::call_once(m_lazy->once, [this]()
+	{
+		// taken out first, so that a failed attempt never touches data again (it might not be valid anymore)
+		const QByteArray data = m_lazy->data;
+		m_lazy->data = QByteArray();
+
+		// lazy packages are only ever created through createLazy, so this never is really const
+		Package *self = const_cast<Package *>(this);
+		QDataStream str(data);
+		str.setVersion(QDataStream::Qt_5_0);
+		QString name;
+		Version version;
+		str >> name >> version >> self->m_paths >> self->m_mirrors >> self->m_dependencies;
+		if (str.status() != QDataStream::Ok) {
+			throw Exception(QString("Unable to read package %1, the package cache might be corrupt") % m_name);
+		}
+	});
+}
+
 QJsonObject Package::toJson() const
 {
 	QJsonObject obj;
@@ -70,5 +113,25 @@ const Package *Package::fromJson(const QJsonDocument &doc, Package *package)
 	}
 }
 
+QDataStream &operator<<(QDataStream &stream, const Package &package)
+{
+	return stream << package.name() << package.version() << package.paths() << package.mirrors() << package.dependencies();
+}
+QDataStream &operator>>(QDataStream &stream, Package &package)
+{
+	QString name;
+	Version version;
+	QHash<QString, QString> paths;
+	QVector<PackageMirror> mirrors;
+	QVector<PackageDependency> dependencies;
+	stream >> name >> version >> paths >> mirrors >> dependencies;
+	package.setName(name);
+	package.setVersion(version);
+	package.setPaths(paths);
+	package.setMirrors(mirrors);
+	package.setDependencies(dependencies);
+	return stream;
+}
+
 }
 }
@@ -23,6 +23,7 @@
 #include "PackageMirror.h"
 #include "PackageDependency.h"
 
+class QDataStream;
 class QJsonDocument;
 class QJsonObject;
 
@@ -42,26 +43,45 @@ public: // properties
 	Version version() const { return m_version; }
 	void setVersion(const Version &version) { m_version = version; }
 
-	QVector<PackageDependency> dependencies() const { return m_dependencies; }
-	void setDependencies(const QVector<PackageDependency> &dependencies) { m_dependencies = dependencies; }
+	QVector<PackageDependency> dependencies() const { ensureLoaded(); return m_dependencies; }
+	void setDependencies(const QVector<PackageDependency> &dependencies) { ensureLoaded(); m_dependencies = dependencies; }
 
-	QVector<PackageMirror> mirrors() const { return m_mirrors; }
-	void setMirrors(QVector<PackageMirror> mirrors) { m_mirrors = mirrors; }
+	QVector<PackageMirror> mirrors() const { ensureLoaded(); return m_mirrors; }
+	void setMirrors(QVector<PackageMirror> mirrors) { ensureLoaded(); m_mirrors = mirrors; }
 
-	QHash<QString, QString> paths() const { return m_paths; }
-	void setPaths(const QHash<QString, QString> &paths) { m_paths = paths; }
+	QHash<QString, QString> paths() const { ensureLoaded(); return m_paths; }
+	void setPaths(const QHash<QString, QString> &paths) { ensureLoaded(); m_paths = paths; }
 
 public: //serialization
 	QJsonObject toJson() const;
 	static const Package *fromJson(const QJsonDocument &doc, Package *package = nullptr);
 
+	/// Only reads name and version from data (as written by operator<<), everything else is read on first access.
+	/// data has to stay valid until then, or until ensureLoaded() is called. Returns nullptr if data is invalid.
+	static Package *createLazy(const QByteArray &data);
+	/// Reads everything that was deferred by createLazy, throws if that fails
+	void ensureLoaded() const
+	{
+		if (m_lazy) {
+			loadLazy();
+		}
+	}
+
 private:
 	QString m_name;
 	Version m_version;
 	QVector<PackageDependency> m_dependencies;
 	QVector<PackageMirror> m_mirrors;
 	QHash<QString, QString> m_paths;
+
+	struct Lazy;
+	std::shared_ptr<Lazy> m_lazy;
+	void loadLazy() const;
 };
 
+// binary form for the package cache, see PackageDatabase::build
+QDataStream &operator<<(QDataStream &stream, const Package &package);
+QDataStream &operator>>(QDataStream &stream, Package &package);
+
 }
 }
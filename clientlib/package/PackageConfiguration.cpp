@@ -15,6 +15,7 @@
 
 #include "PackageConfiguration.h"
 
+#include <QDataStream>
 #include <QRegularExpression>
 
 #include "Json.h"
@@ -86,5 +87,14 @@ PackageConfiguration PackageConfiguration::fromJson(const QJsonObject &obj)
 	return config;
 }
 
+
+QDataStream &operator<<(QDataStream &stream, const PackageConfiguration &config)
+{
+	return stream << config.m_values;
+}
+QDataStream &operator>>(QDataStream &stream, PackageConfiguration &config)
+{
+	return stream >> config.m_values;
+}
 }
 }
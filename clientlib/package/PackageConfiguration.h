@@ -59,6 +59,8 @@ public: // convenience helpers
 public: // serialization
 	QJsonObject toJson() const;
 	static PackageConfiguration fromJson(const QJsonObject &obj);
+	friend QDataStream &operator<<(QDataStream &stream, const PackageConfiguration &config);
+	friend QDataStream &operator>>(QDataStream &stream, PackageConfiguration &config);
 
 private:
 	QHash<QString, QVariant> m_values;
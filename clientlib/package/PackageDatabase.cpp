@@ -16,28 +16,83 @@
 #include "PackageDatabase.h"
 
 #include <QDataStream>
+#include <QFileInfo>
+#include <QPair>
+#include <QSet>
 #include <QStandardPaths>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iterator>
 
 #include "Functional.h"
 #include "Exception.h"
 #include "Json.h"
+#include "future/FutureCombinators.h"
 #include "PackageSource.h"
 #include "PackageGroup.h"
 #include "Package.h"
+#include "PackageIndex.h"
 
 namespace Ralph {
 using namespace Common;
 
 namespace ClientLib {
 
+// bumped whenever the packages of any database change, since that also changes the merged view of everything inheriting it
+static std::atomic<quint64> s_packagesEpoch{0};
+
+using Clock = std::chrono::steady_clock;
+static qint64 microsecondsSince(const Clock::time_point &start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
 PackageDatabase::PackageDatabase(const QDir &dir, const QVector<PackageDatabase *> &inherits)
-	: m_dir(dir), m_inherits(inherits), m_mutex(QMutex::Recursive)
+	: m_dir(dir), m_inherits(inherits), m_mutex(QMutex::Recursive), m_snapshot(std::make_shared<Snapshot>())
 {
 }
 
+// see setKeepLoaded
+static std::mutex s_keptMutex;
+static bool s_keepLoaded = false;
+static QHash<QString, Future<PackageDatabase *>> s_kept;
+static QVector<PackageDatabase *> s_loaded;
+
 Future<PackageDatabase *> PackageDatabase::get(const QDir &dir, const QVector<PackageDatabase *> inherits)
 {
-	return async([dir, inherits](Notifier notifier) -> PackageDatabase *
+	{
+		std::lock_guard<std::mutex> lock(s_keptMutex);
+		if (!s_keepLoaded) {
+			return open(dir, inherits);
+		}
+		const auto it = s_kept.constFind(dir.absolutePath());
+		if (it != s_kept.constEnd()) {
+			return *it;
+		}
+	}
+
+	Future<PackageDatabase *> future = open(dir, inherits).then([](PackageDatabase *db)
+	{
+		if (db) {
+			std::lock_guard<std::mutex> lock(s_keptMutex);
+			s_loaded.append(db);
+		}
+		return db;
+	});
+	std::lock_guard<std::mutex> lock(s_keptMutex);
+	// somebody else might have been quicker, ours has not been started yet so we can just drop it
+	const auto it = s_kept.constFind(dir.absolutePath());
+	if (it != s_kept.constEnd()) {
+		return *it;
+	}
+	s_kept.insert(dir.absolutePath(), future);
+	return future;
+}
+Future<PackageDatabase *> PackageDatabase::open(const QDir &dir, const QVector<PackageDatabase *> &inherits)
+{
+	return async([dir, inherits]() -> PackageDatabase *
 	{
 		if (!dir.exists()) {
 			if (!dir.mkpath(dir.absolutePath())) {
@@ -47,19 +102,22 @@ Future<PackageDatabase *> PackageDatabase::get(const QDir &dir, const QVector<Pa
 
 		PackageDatabase *db = new PackageDatabase(dir, Functional::filter(inherits, Functional::IsNull));
 		db->load();
-		notifier.await(db->build());
 		return db;
 	});
 }
 Future<PackageDatabase *> PackageDatabase::create(const QString &dir)
 {
-	return async([dir](Notifier notifier) -> PackageDatabase *
-	{
-		const QString userDir = databasePath("user");
-		const QString systemDir = databasePath("system");
+	const QString userDir = databasePath("user");
+	const QString systemDir = databasePath("system");
 
-		PackageDatabase *system = systemDir.isNull() ? nullptr : notifier.await(PackageDatabase::get(databasePath("system")));
-		PackageDatabase *user = userDir.isEmpty() ? nullptr : notifier.await(PackageDatabase::get(userDir, {system}));
+	// the layers are independent until they are linked together, so all of them are loaded and indexed at the same time
+	auto getIf = [](const QString &path) { return path.isEmpty() ? makeReadyFuture<PackageDatabase *>(nullptr) : PackageDatabase::get(path); };
+	return whenAll(QVector<Future<PackageDatabase *>>{getIf(systemDir), getIf(userDir), getIf(dir)})
+			.then([dir](const QVector<PackageDatabase *> &layers, Notifier notifier)
+	{
+		PackageDatabase *system = layers.at(0);
+		PackageDatabase *user = layers.at(1);
+		PackageDatabase *project = layers.at(2);
 
 		// system -> user -> local, if no user db is available, but a system db is, it's system -> local
 		PackageDatabase *global = (system && !user) ? system : user;
@@ -69,16 +127,18 @@ Future<PackageDatabase *> PackageDatabase::create(const QString &dir)
 		}
 		if (user) {
 			notifier.status("Using database: user");
+			user->inherit({system});
 		}
-
-		PackageDatabase *db;
-		if (!dir.isNull()) {
-			db = notifier.await(PackageDatabase::get(dir, {global}));
-			notifier.status("Using database: project");
-		} else {
-			db = global;
+		if (dir.isNull()) {
+			return global;
 		}
-
+		notifier.status("Using database: project");
+		if (project) {
+			project->inherit({global});
+		}
+		return project;
+	}).then([](PackageDatabase *db)
+	{
 		if (!db) {
 			throw Exception("Error: Unable to load any package database");
 		}
@@ -88,6 +148,10 @@ Future<PackageDatabase *> PackageDatabase::create(const QString &dir)
 
 QString PackageDatabase::databasePath(const QString &type)
 {
+	const QByteArray variable = "RALPH_" + type.toUpper().toLatin1() + "_DATABASE";
+	if (qEnvironmentVariableIsSet(variable.constData())) {
+		return QString::fromLocal8Bit(qgetenv(variable.constData()));
+	}
 	if (type == "user") {
 		return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
 #ifdef Q_OS_LINUX
@@ -99,6 +163,38 @@ QString PackageDatabase::databasePath(const QString &type)
 	}
 }
 
+void PackageDatabase::setKeepLoaded(const bool keepLoaded)
+{
+	std::lock_guard<std::mutex> lock(s_keptMutex);
+	s_keepLoaded = keepLoaded;
+	if (!keepLoaded) {
+		s_kept.clear();
+		s_loaded.clear();
+	}
+}
+QVector<PackageDatabase *> PackageDatabase::loadedDatabases()
+{
+	std::lock_guard<std::mutex> lock(s_keptMutex);
+	return s_loaded;
+}
+
+void PackageDatabase::inherit(const QVector<PackageDatabase *> &inherits)
+{
+	const QVector<PackageDatabase *> filtered = Functional::filter(inherits, Functional::IsNull);
+	std::lock_guard<std::mutex> lock(m_mergedMutex);
+	// kept databases are linked again by every create(), but never differently
+	if (filtered == m_inherits) {
+		return;
+	}
+	m_inherits = filtered;
+	++s_packagesEpoch;
+}
+QVector<PackageDatabase *> PackageDatabase::inheritedDatabases() const
+{
+	std::lock_guard<std::mutex> lock(m_mergedMutex);
+	return m_inherits;
+}
+
 bool PackageDatabase::isReadonly() const
 {
 	return !QFileInfo(m_dir.absolutePath()).isWritable();
@@ -108,18 +204,24 @@ void PackageDatabase::load()
 {
 	using namespace Json;
 	QMutexLocker locker(&m_mutex);
+	const Clock::time_point start = Clock::now();
 	if (m_dir.exists("db.json")) {
 		const QJsonObject root = ensureObject(ensureDocument(m_dir.absoluteFilePath("db.json")));
+		m_dbModified = QFileInfo(m_dir.absoluteFilePath("db.json")).lastModified();
 
+		const QVector<PackageSource *> previous = m_sources;
 		m_sources = Functional::collection(ensureIsArrayOf<QJsonObject>(root, "sources"))
 				.map([](const QJsonObject &o) { return PackageSource::fromJson(o); })
 				.tap([this](PackageSource *source) { source->setBasePath(m_dir.absoluteFilePath("sources/" + source->name())); });
+		qDeleteAll(previous);
+		sourcesChanged();
 
 		m_groups = Functional::map(ensureIsArrayOf<QJsonObject>(root, "groups", QVector<QJsonObject>()), [this](const QJsonObject &obj)
 		{
 			return PackageGroup{ensureString(obj, "name"), m_dir.absoluteFilePath(ensureString(obj, "dir"))};
 		});
 	}
+	m_stats.loadTime += microsecondsSince(start);
 }
 void PackageDatabase::save()
 {
@@ -135,86 +237,469 @@ void PackageDatabase::save()
 						   });
 	})));
 	write(obj, m_dir.absoluteFilePath("db.json"));
+	m_dbModified = QFileInfo(m_dir.absoluteFilePath("db.json")).lastModified();
+}
+bool PackageDatabase::isOutdated() const
+{
+	QMutexLocker locker(&m_mutex);
+	return QFileInfo(m_dir.absoluteFilePath("db.json")).lastModified() != m_dbModified
+			|| QFileInfo(m_dir.absoluteFilePath("cache.dat")).lastModified() != m_indexModified;
 }
 
-Future<void> PackageDatabase::build()
+void PackageDatabase::sourcesChanged()
+{
+	QMutexLocker locker(&m_mutex);
+	// rebuilt on the next query, which might never come, builds that are running already no longer count
+	++m_generation;
+	m_built = false;
+}
+
+QHash<QString, QDateTime> PackageDatabase::sourceTimestamps() const
+{
+	QMutexLocker locker(&m_mutex);
+	QHash<QString, QDateTime> timestamps;
+	for (const PackageSource *src : m_sources) {
+		timestamps.insert(src->name(), src->lastUpdated());
+	}
+	return timestamps;
+}
+bool PackageDatabase::openIndex()
 {
-	return async([this](Notifier notifier)
+	QHash<QString, QDateTime> timestamps;
+	quint64 generation;
 	{
 		QMutexLocker locker(&m_mutex);
+		timestamps = sourceTimestamps();
+		generation = m_generation;
+	}
+	std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+	if (!snapshot->index.open(m_dir.absoluteFilePath("cache.dat")) || snapshot->index.sourceTimestamps() != timestamps) {
+		return false;
+	}
+	publish(snapshot, generation);
+	QMutexLocker locker(&m_mutex);
+	m_indexModified = QFileInfo(m_dir.absoluteFilePath("cache.dat")).lastModified();
+	return true;
+}
+bool PackageDatabase::writeIndex(const QHash<QString, QDateTime> &timestamps, const QHash<QString, QString> &revisions, const QVector<PackageIndex::Record> &records,
+								 const quint64 generation)
+{
+	try {
+		// written to a temporary file and renamed, so the index of the current snapshot stays intact
+		PackageIndex::write(m_dir.absoluteFilePath("cache.dat"), timestamps, revisions, records);
+	} catch (PackageIndexException &) {
+		return false;
+	}
+	std::shared_ptr<Snapshot> snapshot = std::make_shared<Snapshot>();
+	if (!snapshot->index.open(m_dir.absoluteFilePath("cache.dat"))) {
+		return false;
+	}
+	publish(snapshot, generation);
+	QMutexLocker locker(&m_mutex);
+	m_indexModified = QFileInfo(m_dir.absoluteFilePath("cache.dat")).lastModified();
+	return true;
+}
 
-		// step 1: read the cache and check if we actually changed
-		{
-			QFile f(m_dir.absoluteFilePath("cache.dat"));
-			if (f.open(QFile::ReadOnly)) {
-				QDataStream str(&f);
-				QHash<QString, QDateTime> cacheSources;
-				str >> cacheSources;
-
-				QHash<QString, QDateTime> currentSources;
-				for (const PackageSource *src : m_sources) {
-					currentSources.insert(src->name(), src->lastUpdated());
-				}
+static bool versionLess(const Package *a, const Package *b)
+{
+	return a->version() < b->version();
+}
+
+static QHash<QString, QVector<const Package *>> mappingFor(const QVector<const Package *> &packages)
+{
+	QHash<QString, QVector<const Package *>> mapping;
+	for (const Package *pkg : packages) {
+		mapping[pkg->name().toLower()].append(pkg);
+	}
+	for (QVector<const Package *> &versions : mapping) {
+		std::stable_sort(versions.begin(), versions.end(), &versionLess);
+	}
+	return mapping;
+}
+
+PackageDatabase::Snapshot::Snapshot(const QVector<const Package *> &pkgs)
+	: packages(pkgs), mapping(mappingFor(pkgs)), memorySearch(mapping.keys().toVector())
+{
+}
+PackageDatabase::Snapshot::~Snapshot()
+{
+	qDeleteAll(packages);
+}
+QVector<const Package *> PackageDatabase::Snapshot::find(const QString &name) const
+{
+	return index.isOpen() ? index.find(name) : mapping.value(name);
+}
+QVector<QString> PackageDatabase::Snapshot::names() const
+{
+	return index.isOpen() ? index.names() : mapping.keys().toVector();
+}
+std::shared_ptr<const PackageDatabase::Snapshot> PackageDatabase::snapshot() const
+{
+	return std::atomic_load(&m_snapshot);
+}
+void PackageDatabase::publish(const std::shared_ptr<const Snapshot> &snapshot, const quint64 generation)
+{
+	QMutexLocker locker(&m_mutex);
+	m_retired.push_back(std::atomic_exchange(&m_snapshot, snapshot));
+	// a build that started before the sources changed is still better than nothing, but not what we need
+	m_built = generation == m_generation;
+	// only after the swap, so that whoever sees the new epoch also sees the new snapshot
+	++s_packagesEpoch;
+	// and only after that merged() no longer returns what it memoized from them. The ones only we still have are
+	// not pinned, so they are freed, even though a reader without a pin might still have a pointer from them
+	m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(), [](const std::shared_ptr<const Snapshot> &retired) { return retired.use_count() == 1; }),
+					m_retired.end());
+}
+void PackageDatabase::ensureBuilt() const
+{
+	// every layer is needed for the answer, so on a cold start they all build at once and we wait for the slowest,
+	// instead of for the sum of them
+	QVector<const PackageDatabase *> layers{this};
+	for (int i = 0; i < layers.size(); ++i) {
+		for (const PackageDatabase *db : layers.at(i)->inheritedDatabases()) {
+			if (!layers.contains(db)) {
+				layers.append(db);
+			}
+		}
+	}
 
-				if (cacheSources == currentSources) {
-					// TODO read the packages from the cache
-					return;
+	// the sources might change again while we build, in which case we are still not built afterwards
+	while (std::any_of(layers.cbegin(), layers.cend(), [](const PackageDatabase *db) { return !db->m_built; })) {
+		QVector<QPair<const PackageDatabase *, std::shared_ptr<Future<void>>>> builds;
+		for (const PackageDatabase *db : layers) {
+			if (!db->m_built) {
+				builds.append(qMakePair(db, db->startBuild()));
+			}
+		}
+		// not whenAll, it would cancel the builds of the other layers if one fails, but they are shared with other readers
+		std::exception_ptr error;
+		for (const auto &build : builds) {
+			Future<void> future = *build.second;
+			try {
+				future.result();
+			} catch (...) {
+				if (!error) {
+					error = std::current_exception();
 				}
 			}
+			build.first->buildFinished(build.second);
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+}
+std::shared_ptr<Future<void>> PackageDatabase::startBuild() const
+{
+	// everybody else waits for the first one to finish, instead of all of them reading every manifest
+	std::shared_ptr<Future<void>> building;
+	{
+		std::lock_guard<std::mutex> lock(m_buildMutex);
+		if (!m_building) {
+			m_building = std::make_shared<Future<void>>(const_cast<PackageDatabase *>(this)->build());
+		}
+		building = m_building;
+	}
+	// not holding the lock while it runs, the build itself might need it (through reading an inherited database for example)
+	building->start();
+	return building;
+}
+void PackageDatabase::buildFinished(const std::shared_ptr<Future<void>> &building) const
+{
+	std::lock_guard<std::mutex> lock(m_buildMutex);
+	if (m_building == building) {
+		m_building.reset();
+	}
+}
+QVector<const Package *> PackageDatabase::merged(const QString &name) const
+{
+	ensureBuilt();
+	return mergeLayers(name.toLower());
+}
+QVector<const Package *> PackageDatabase::mergeLayers(const QString &key) const
+{
+	// read before looking anything up, so that a change while we are doing so invalidates what we store
+	const quint64 epoch = s_packagesEpoch;
+	QVector<PackageDatabase *> inherits;
+	{
+		std::lock_guard<std::mutex> lock(m_mergedMutex);
+		if (m_mergedEpoch != epoch) {
+			m_merged.clear();
+			m_mergedEpoch = epoch;
+		}
+		const auto it = m_merged.constFind(key);
+		if (it != m_merged.constEnd()) {
+			return it.value();
+		}
+		inherits = m_inherits;
+	}
+
+	// all lists are sorted, and merging keeps equal versions from earlier lists first
+	QVector<const Package *> out = snapshot()->find(key);
+	for (const PackageDatabase *db : inherits) {
+		const QVector<const Package *> inherited = db->mergeLayers(key);
+		QVector<const Package *> both;
+		both.reserve(out.size() + inherited.size());
+		std::merge(out.cbegin(), out.cend(), inherited.cbegin(), inherited.cend(), std::back_inserter(both), &versionLess);
+		out = both;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mergedMutex);
+	if (m_mergedEpoch == epoch) {
+		m_merged.insert(key, out);
+	}
+	return out;
+}
+
+namespace {
+struct SourceIndex
+{
+	QString source;
+	QString revision;
+	QVector<PackageIndex::Record> records;
+};
+}
+
+// re-reads what changed in src since the previous index was written, all other records are reused as they are
+static Future<SourceIndex> reindexSource(const PackageSource *src, const PackageIndex &previous)
+{
+	const QString name = src->name();
+	SourceIndex kept{name, previous.sourceRevisions().value(name), previous.records(name)};
+	if (previous.sourceTimestamps().contains(name) && previous.sourceTimestamps().value(name) == src->lastUpdated()) {
+		return makeReadyFuture(kept);
+	}
+
+	return async([src, kept](Notifier notifier)
+	{
+		auto toRecords = [src](const QVector<PackageSource::Manifest> &manifests)
+		{
+			// the index takes over from here, packages are materialized from it again when needed
+			QVector<PackageIndex::Record> records;
+			for (const PackageSource::Manifest &manifest : manifests) {
+				records.append(PackageIndex::Record::fromPackage(src->name(), manifest.path, manifest.package));
+				delete manifest.package;
+			}
+			return records;
+		};
+
+		QString revision;
+		try {
+			revision = notifier.await(src->revision());
+		} catch (CanceledException &) {
+			throw;
+		} catch (Exception &) {
+			// no revision means no incremental update next time either, but we can still read everything
+		}
+
+		if (!revision.isEmpty() && !kept.revision.isEmpty()) {
+			try {
+				const QVector<QString> changed = notifier.await(src->changedManifests(kept.revision));
+				notifier.status("Updating %1 changed packages for '%2'..." % QString::number(changed.size()) % src->name());
+				const QSet<QString> changedSet = changed.toList().toSet();
+				SourceIndex updated{src->name(), revision, Functional::filter(kept.records, [changedSet](const PackageIndex::Record &record)
+				{
+					return !changedSet.contains(record.path);
+				})};
+				updated.records += toRecords(notifier.await(src->manifests(changed)));
+				return updated;
+			} catch (CanceledException &) {
+				throw;
+			} catch (Exception &) {
+				// for example if the indexed revision no longer exists after a force push, fall back to reading everything
+			}
 		}
 
-		// step 2: read all packages from all sources
+		notifier.status("Reading packages for '%1'..." % src->name());
+		return SourceIndex{src->name(), revision, toRecords(notifier.await(src->manifests()))};
+	});
+}
+
+Future<void> PackageDatabase::reload()
+{
+	return async([this]()
+	{
+		load();
+	}).then([this]()
+	{
+		return build();
+	});
+}
+
+Future<void> PackageDatabase::build()
+{
+	// set once we actually start, which might be long after build() was called
+	const std::shared_ptr<Clock::time_point> start = std::make_shared<Clock::time_point>();
+
+	// step 1: use the index if none of the sources have changed since it was written
+	return async([this, start]()
+	{
+		*start = Clock::now();
+		return openIndex();
+	}).then([this](const bool upToDate)
+	{
 		{
-			m_packageMapping.clear();
-			m_packages = Functional::collection(m_sources)
-					.map([this, notifier](const PackageSource *src)
-			{
-				notifier.status("Reading packages for '%1'..." % src->name());
-				return notifier.await(src->packages());
-			})
-					.flatten()
-					.tap([this](const Package *pkg) { m_packageMapping.insert(pkg->name().toLower(), pkg); });
+			QMutexLocker locker(&m_mutex);
+			m_stats.cacheHit = upToDate;
+		}
+		if (upToDate) {
+			return makeReadyFuture();
 		}
 
-		// step 3: write the cache
+		// step 2: reindex all sources concurrently, only re-reading manifests that changed since the last index
+		PackageIndex previous;
+		previous.open(m_dir.absoluteFilePath("cache.dat"));
+		QHash<QString, QDateTime> timestamps;
+		QVector<Future<SourceIndex>> perSource;
+		quint64 generation;
 		{
-			// TODO write packages into the cache.dat file
-			// wait until it's actually needed though
+			QMutexLocker locker(&m_mutex);
+			timestamps = sourceTimestamps();
+			perSource = Functional::map(m_sources, [&previous](const PackageSource *src) { return reindexSource(src, previous); });
+			generation = m_generation;
 		}
+		return whenAll(perSource).then([this, timestamps, generation](const QVector<SourceIndex> &indexed)
+		{
+			QHash<QString, QString> revisions;
+			QVector<PackageIndex::Record> records;
+			for (const SourceIndex &source : indexed) {
+				revisions.insert(source.source, source.revision);
+				records += source.records;
+			}
+
+			// step 3: write and switch to the new index, or keep everything in memory if we can't write it
+			if (!isReadonly() && writeIndex(timestamps, revisions, records, generation)) {
+				return;
+			}
+			publish(std::make_shared<Snapshot>(Functional::map2<QVector<const Package *>>(records, [](const PackageIndex::Record &record) -> const Package *
+			{
+				return record.package();
+			})), generation);
+		});
+	}).then([this, start]()
+	{
+		QMutexLocker locker(&m_mutex);
+		m_stats.buildTime += microsecondsSince(*start);
+		++m_stats.builds;
 	});
 }
 
-const Package *PackageDatabase::getPackage(const QString &name, const Version &version) const
+PackageDatabase::Stats PackageDatabase::stats() const
 {
-	QMutexLocker locker(&m_mutex);
-	for (const Package *pkg : m_packageMapping.values(name)) {
-		if (pkg->version() == version) {
-			return pkg;
+	Stats out;
+	{
+		QMutexLocker locker(&m_mutex);
+		out = m_stats;
+		out.sources = m_sources.size();
+		for (const PackageSource *source : m_sources) {
+			const PackageSource::ParseStats parsed = source->parseStats();
+			out.bytesParsed += parsed.bytes;
+			out.parseTime += parsed.parseTime;
+			out.fromJsonTime += parsed.fromJsonTime;
 		}
 	}
-	for (const PackageDatabase *db : m_inherits) {
-		const Package *pkg = db->getPackage(name, version);
-		if (pkg) {
-			return pkg;
-		}
+	const std::shared_ptr<const Snapshot> current = snapshot();
+	if (current->index.isOpen()) {
+		out.manifests = int(current->index.recordCount());
+		out.indexSize = current->index.size();
+		out.indexResident = current->index.residentSize();
+	} else {
+		out.manifests = current->packages.size();
 	}
-	return nullptr;
+	return out;
+}
+
+using PackageIterator = QVector<const Package *>::const_iterator;
+static PackageIterator lowerBound(const QVector<const Package *> &sorted, const Version &version)
+{
+	return std::lower_bound(sorted.cbegin(), sorted.cend(), version, [](const Package *pkg, const Version &v) { return pkg->version() < v; });
+}
+static PackageIterator upperBound(const QVector<const Package *> &sorted, const Version &version)
+{
+	return std::upper_bound(sorted.cbegin(), sorted.cend(), version, [](const Version &v, const Package *pkg) { return v < pkg->version(); });
+}
+// the part of sorted that requirement can accept, found by binary search
+static QPair<PackageIterator, PackageIterator> acceptedRange(const QVector<const Package *> &sorted, const VersionRequirement &requirement)
+{
+	if (!requirement.isValid()) {
+		return qMakePair(sorted.cbegin(), sorted.cend());
+	}
+	switch (requirement.type()) {
+	case VersionRequirement::Less: return qMakePair(sorted.cbegin(), lowerBound(sorted, requirement.version()));
+	case VersionRequirement::LessEqual: return qMakePair(sorted.cbegin(), upperBound(sorted, requirement.version()));
+	case VersionRequirement::Greater: return qMakePair(upperBound(sorted, requirement.version()), sorted.cend());
+	case VersionRequirement::GreaterEqual: return qMakePair(lowerBound(sorted, requirement.version()), sorted.cend());
+	case VersionRequirement::Equal: return qMakePair(lowerBound(sorted, requirement.version()), upperBound(sorted, requirement.version()));
+	case VersionRequirement::NonEqual: return qMakePair(sorted.cbegin(), sorted.cend());
+	}
+}
+// within acceptedRange only the version type (and != requirements) are left to check
+static bool isAccepted(const Package *pkg, const VersionRequirement &requirement)
+{
+	if (!requirement.isValid()) {
+		return true;
+	}
+	return requirement.type() == VersionRequirement::NonEqual ? requirement.accepts(pkg->version()) : pkg->version().type() >= requirement.allowedType();
+}
+
+const Package *PackageDatabase::getPackage(const QString &name, const Version &version) const
+{
+	const QVector<const Package *> versions = merged(name);
+	const PackageIterator it = lowerBound(versions, version);
+	return it != versions.cend() && (*it)->version() == version ? *it : nullptr;
 }
 QVector<const Package *> PackageDatabase::findPackages(const QString &name, const VersionRequirement &version) const
 {
-	QMutexLocker locker(&m_mutex);
+	const QVector<const Package *> versions = merged(name);
+	const QPair<PackageIterator, PackageIterator> range = acceptedRange(versions, version);
 	QVector<const Package *> out;
-	out.append(Functional::filter2<QVector<const Package *>>(m_packageMapping.values(name.toLower()), [version](const Package *pkg) { return !version.isValid() || version.accepts(pkg->version()); }));
-	for (const PackageDatabase *db : m_inherits) {
-		out.append(db->findPackages(name, version));
-	}
+	std::copy_if(range.first, range.second, std::back_inserter(out), [version](const Package *pkg) { return isAccepted(pkg, version); });
 	return out;
 }
+const Package *PackageDatabase::bestPackage(const QString &name, const VersionRequirement &version) const
+{
+	const QVector<const Package *> versions = merged(name);
+	const QPair<PackageIterator, PackageIterator> range = acceptedRange(versions, version);
+	// usually the very first one we look at
+	for (PackageIterator it = range.second; it != range.first; --it) {
+		if (isAccepted(*(it - 1), version)) {
+			// equal versions are in order of precedence, so go to the first of them
+			return *lowerBound(versions, (*(it - 1))->version());
+		}
+	}
+	return nullptr;
+}
+
+PackageDatabase::Pin PackageDatabase::pin() const
+{
+	ensureBuilt();
+	std::vector<Pin> pins{snapshot()};
+	for (const PackageDatabase *db : inheritedDatabases()) {
+		pins.push_back(db->pin());
+	}
+	return std::make_shared<const std::vector<Pin>>(std::move(pins));
+}
 
 QVector<QString> PackageDatabase::packageNames() const
 {
-	QMutexLocker locker(&m_mutex);
-	return m_packageMapping.keys().toVector();
+	ensureBuilt();
+	return snapshot()->names();
+}
+QVector<NameSearch::Match> PackageDatabase::search(const QString &query, const int limit) const
+{
+	ensureBuilt();
+	const std::shared_ptr<const Snapshot> current = snapshot();
+	QVector<NameSearch::Match> matches = current->index.isOpen() ? current->index.search(query, limit) : current->memorySearch.search(query, limit);
+	for (const PackageDatabase *db : inheritedDatabases()) {
+		matches += db->search(query, limit);
+	}
+
+	// the rank only depends on the name, so a name that is in several databases ends up next to itself
+	std::sort(matches.begin(), matches.end());
+	matches.erase(std::unique(matches.begin(), matches.end(), [](const NameSearch::Match &a, const NameSearch::Match &b) { return a.name == b.name; }), matches.end());
+	if (limit > 0 && matches.size() > limit) {
+		matches.resize(limit);
+	}
+	return matches;
 }
 
 PackageSource *PackageDatabase::source(const QString &name) const
@@ -228,19 +713,18 @@ PackageSource *PackageDatabase::source(const QString &name) const
 }
 Future<void> PackageDatabase::registerPackageSource(PackageSource *source)
 {
-	return async([this, source](Notifier notifier)
+	return async([this, source]()
 	{
+		QMutexLocker locker(&m_mutex);
 		auto it = std::find_if(m_sources.begin(), m_sources.end(), [source](const PackageSource *src) { return src->name() == source->name(); });
 		if (it != m_sources.end()) {
 			throw Exception("A source with the name '%1' already exists in the current database" % source->name());
 		}
-
-		QMutexLocker locker(&m_mutex);
 		m_sources.append(source);
 		source->setBasePath(m_dir.absoluteFilePath("sources/" + source->name()));
 
 		save();
-		notifier.await(build());
+		sourcesChanged();
 	});
 }
 Future<void> PackageDatabase::unregisterPackageSource(const QString &name)
@@ -260,7 +744,7 @@ Future<void> PackageDatabase::unregisterPackageSource(const QString &name)
 		}
 
 		save();
-		notifier.await(build());
+		sourcesChanged();
 	});
 }
 
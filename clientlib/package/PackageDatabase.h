@@ -16,10 +16,17 @@
 #pragma once
 
 #include <QFuture>
+#include <QDateTime>
 #include <QDir>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include "task/Task.h"
 #include "PackageGroup.h"
+#include "PackageIndex.h"
+#include "NameSearch.h"
 #include "Version.h"
 
 namespace Ralph {
@@ -34,43 +41,148 @@ class PackageDatabase
 public:
 	static Future<PackageDatabase *> get(const QDir &dir, const QVector<PackageDatabase *> inherits = {});
 	static Future<PackageDatabase *> create(const QString &dir);
+	/// Where the "user" and "system" databases are, unless overridden by RALPH_USER_DATABASE or RALPH_SYSTEM_DATABASE
 	static QString databasePath(const QString &type);
 
+	/// Makes get() return the same database again for the same directory instead of loading it anew, for long running processes
+	static void setKeepLoaded(const bool keepLoaded);
+	/// All databases that have been loaded and are kept, see setKeepLoaded
+	static QVector<PackageDatabase *> loadedDatabases();
+
+	QDir dir() const { return m_dir; }
 	bool isReadonly() const;
 
+	/// Only reads db.json, the packages are built on first use (see build)
+	/// Replaces (and deletes) all sources, so nothing may be using them at the same time
 	void load();
+	/// Uses the index if it is up to date, rebuilds it otherwise. Happens automatically on the first package query.
 	Future<void> build();
+	/// Picks up changes made by other processes, like new sources or an updated index, see load() for what may not run at the same time
+	Future<void> reload();
+	/// Whether db.json or cache.dat have been changed since this database last read or wrote them, by another process that is
+	bool isOutdated() const;
 
+	/// Like all packages returned by a database only valid until the database it is from is rebuilt, unless a pin() is held
 	const Package *getPackage(const QString &name, const Version &version) const;
+	/// Sorted by version, lowest first, valid until the next rebuild unless pinned (see getPackage)
 	QVector<const Package *> findPackages(const QString &name, const VersionRequirement &version = VersionRequirement()) const;
+	/// The highest version accepted by version, or nullptr, valid until the next rebuild unless pinned (see getPackage)
+	const Package *bestPackage(const QString &name, const VersionRequirement &version = VersionRequirement()) const;
+
+	/// Keeps all packages currently returned by this and the inherited databases alive while held, even across rebuilds
+	using Pin = std::shared_ptr<const void>;
+	Pin pin() const;
 
 	QVector<QString> packageNames() const;
+	/// Package names matching query from this and all inherited databases, best first, see NameSearch
+	QVector<NameSearch::Match> search(const QString &query, const int limit = 0) const;
 
 	PackageSource *source(const QString &name) const;
 	QVector<PackageSource *> sources() const { return m_sources; }
 	Future<void> registerPackageSource(PackageSource *source);
 	Future<void> unregisterPackageSource(const QString &name);
 
-	QVector<PackageDatabase *> inheritedDatabases() const { return m_inherits; }
+	QVector<PackageDatabase *> inheritedDatabases() const;
+
+	/// Where loading and building this database spent its time, see `ralph db stats`
+	struct Stats
+	{
+		int sources = 0;
+		int manifests = 0; ///< In the current packages
+		qint64 bytesParsed = 0;
+		qint64 loadTime = 0; ///< Microseconds, all times are totals since this database was opened
+		qint64 buildTime = 0;
+		qint64 parseTime = 0; ///< Spent parsing the JSON of manifests, part of buildTime
+		qint64 fromJsonTime = 0; ///< Spent in Package::fromJson, part of buildTime
+		int builds = 0;
+		bool cacheHit = false; ///< Whether the last build could use cache.dat as-is
+		qint64 indexSize = 0; ///< Of cache.dat, 0 if the packages are only kept in memory
+		qint64 indexResident = 0; ///< How much of cache.dat is currently in memory
+	};
+	Stats stats() const;
 
 	PackageGroup group(const QString &name = QString());
 	QVector<PackageGroup> groups() const { return m_groups; }
 
 private: // internal
+	static Future<PackageDatabase *> open(const QDir &dir, const QVector<PackageDatabase *> &inherits);
+	/// Links this database to the ones it inherits from, done by create() once all of them are loaded
+	void inherit(const QVector<PackageDatabase *> &inherits);
 	void save();
+	/// Call with m_mutex held after changing m_sources
+	void sourcesChanged();
+
+	QHash<QString, QDateTime> sourceTimestamps() const;
+	/// Maps cache.dat if it exists and is up to date, see PackageIndex
+	bool openIndex();
+	/// Writes and maps cache.dat, returns false if that was not possible
+	bool writeIndex(const QHash<QString, QDateTime> &timestamps, const QHash<QString, QString> &revisions, const QVector<PackageIndex::Record> &records,
+					const quint64 generation);
+	/// Runs build() if no packages have been published yet, or sources were added or removed since, for this and
+	/// all inherited databases at the same time
+	void ensureBuilt() const;
+	/// The build everybody waits for, started if there is none yet
+	std::shared_ptr<Future<void>> startBuild() const;
+	/// Called by everybody who waited for building once it has finished
+	void buildFinished(const std::shared_ptr<Future<void>> &building) const;
+	/// All versions of name in this and all inherited databases, sorted by version, equal versions in order of precedence
+	QVector<const Package *> merged(const QString &name) const;
+	/// merged() without building first, key is the lower case name
+	QVector<const Package *> mergeLayers(const QString &key) const;
+
+	/// Immutable once published, either the index is open, or all packages have been read and are in packages
+	struct Snapshot
+	{
+		PackageIndex index;
+		QVector<const Package *> packages;
+		QHash<QString, QVector<const Package *>> mapping; ///< Sorted by version, like the index
+		InMemoryNameSearch memorySearch;
+
+		/// Takes ownership of pkgs
+		explicit Snapshot(const QVector<const Package *> &pkgs = {});
+		~Snapshot();
+		/// Sorted by version
+		QVector<const Package *> find(const QString &name) const;
+		QVector<QString> names() const;
+	};
+	std::shared_ptr<const Snapshot> snapshot() const;
+	/// Replaces the current snapshot, readers that already have the old one continue using it
+	/// generation is m_generation when the build read the sources, if they changed since the database is still not built
+	void publish(const std::shared_ptr<const Snapshot> &snapshot, const quint64 generation);
 
 private: // static/on creation
 	const QDir m_dir;
-	const QVector<PackageDatabase *> m_inherits;
+	// set by create() after loading, not used while loading or building, protected by m_mergedMutex since merged() depends on it
+	QVector<PackageDatabase *> m_inherits;
 
 private: // settings, semi-static
 	QVector<PackageSource *> m_sources;
 	QVector<PackageGroup> m_groups;
+	// of db.json and cache.dat when we last read or wrote them, see isOutdated
+	QDateTime m_dbModified;
+	QDateTime m_indexModified;
 
 private: // packages, semi-static
+	// only protects the settings, packages are read without locking through m_snapshot
 	mutable QMutex m_mutex;
-	QVector<const Package *> m_packages;
-	QMultiHash<QString, const Package *> m_packageMapping;
+	// only accessed through std::atomic_load/atomic_store
+	std::shared_ptr<const Snapshot> m_snapshot;
+	// replaced snapshots that are still referenced somewhere else (like a pin), we handed out pointers to their packages
+	std::vector<std::shared_ptr<const Snapshot>> m_retired;
+	// only the times and cacheHit, protected by m_mutex
+	Stats m_stats;
+	// set by publish, cleared when the sources change
+	std::atomic<bool> m_built{false};
+	// incremented whenever the sources change, protected by m_mutex
+	quint64 m_generation = 0;
+	// the build ensureBuilt() started and everybody else waits for, protected by m_buildMutex
+	mutable std::mutex m_buildMutex;
+	mutable std::shared_ptr<Future<void>> m_building;
+	// memoized results of merged(), only valid as long as m_mergedEpoch is the current epoch (see publish)
+	// also protects m_inherits
+	mutable std::mutex m_mergedMutex;
+	mutable QHash<QString, QVector<const Package *>> m_merged;
+	mutable quint64 m_mergedEpoch = 0;
 };
 
 }
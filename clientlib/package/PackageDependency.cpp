@@ -15,6 +15,9 @@
 
 #include "PackageDependency.h"
 
+#include <QDataStream>
+#include <QJsonDocument>
+
 #include "Json.h"
 #include "Functional.h"
 #include "PackageSource.h"
@@ -71,5 +74,36 @@ PackageDependency PackageDependency::fromJson(const QJsonObject &obj)
 	return dep;
 }
 
+QDataStream &operator<<(QDataStream &stream, const PackageDependency &dependency)
+{
+	stream << dependency.package() << dependency.version() << dependency.isOptional() << dependency.config();
+	stream << bool(dependency.requirements());
+	if (dependency.requirements()) {
+		dependency.requirements()->write(stream);
+	}
+	// sources are rare in dependencies, and have no binary form of their own
+	stream << (dependency.source() ? QJsonDocument(dependency.source()->toJson()).toJson(QJsonDocument::Compact) : QByteArray());
+	return stream;
+}
+QDataStream &operator>>(QDataStream &stream, PackageDependency &dependency)
+{
+	QString package;
+	VersionRequirement version;
+	bool optional;
+	PackageConfiguration config;
+	bool hasRequirements;
+	stream >> package >> version >> optional >> config >> hasRequirements;
+	dependency.setPackage(package);
+	dependency.setVersion(version);
+	dependency.setOptional(optional);
+	dependency.setConfig(config);
+	dependency.setRequirements(hasRequirements ? Requirement::read(stream) : RequirementPtr());
+
+	QByteArray source;
+	stream >> source;
+	dependency.setSource(source.isEmpty() ? nullptr : PackageSource::fromJson(QJsonDocument::fromJson(source).object()));
+	return stream;
+}
+
 }
 }
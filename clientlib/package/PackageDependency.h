@@ -20,6 +20,7 @@
 #include "Version.h"
 #include "PackageConfiguration.h"
 
+class QDataStream;
 class QJsonObject;
 
 namespace Ralph {
@@ -62,5 +63,9 @@ private:
 	PackageConfiguration m_config;
 };
 
+// binary form for the package cache
+QDataStream &operator<<(QDataStream &stream, const PackageDependency &dependency);
+QDataStream &operator>>(QDataStream &stream, PackageDependency &dependency);
+
 }
 }
@@ -15,7 +15,9 @@
 
 #include "PackageGroup.h"
 
+#include <QLockFile>
 #include <QTemporaryDir>
+#include <mutex>
 
 #include "ActionContext.h"
 #include "Json.h"
@@ -23,12 +25,37 @@
 #include "PackageMirror.h"
 #include "Functional.h"
 #include "FileSystem.h"
+#include "future/SingleFlight.h"
+#include "task/LockFile.h"
 
 namespace Ralph {
 using namespace Common;
 
 namespace ClientLib {
 
+namespace {
+// several packages of a group might be installed at the same time, each of them rewriting meta.json
+std::mutex s_settingsMutex;
+// installations take a lot longer than the default 30s after which a lock is assumed to be left behind by a crash
+const int s_installLockStaleTime = 60 * 60 * 1000;
+
+/// Held while reading, changing and writing meta.json, by this and by other ralph processes
+class SettingsLock
+{
+	std::lock_guard<std::mutex> m_guard;
+	QLockFile m_file;
+public:
+	explicit SettingsLock(const QDir &dir)
+		: m_guard(s_settingsMutex), m_file(dir.absoluteFilePath("meta.json.lock"))
+	{
+		// only ever held for a moment, so simply waiting is fine
+		if (!m_file.lock()) {
+			throw Exception("Unable to lock %1" % dir.absoluteFilePath("meta.json"));
+		}
+	}
+};
+}
+
 PackageGroup::PackageGroup(const QString &name, const QDir &dir)
 	: m_name(name), m_dir(dir)
 {
@@ -37,43 +64,66 @@ PackageGroup::PackageGroup(const QString &name, const QDir &dir)
 
 Future<void> PackageGroup::install(const Package *pkg, const PackageConfiguration &config)
 {
-	return async([this, pkg, config](Notifier notifier)
-	{
-		readSettings();
-		if (isInstalled(pkg)) {
-			notifier.status("%1 is already installed!" % pkg->name());
-			return;
-		}
-
-		notifier.status("Installing %1 into %2..." % pkg->name() % m_name);
+	// groups are passed around by value, so the continuations work on a copy of their own instead of whatever this is by then
+	std::shared_ptr<PackageGroup> self = std::make_shared<PackageGroup>(*this);
 
-		QTemporaryDir buildDir;
-
-		ActionContext ctxt;
-		ctxt.emplace<InstallContextItem>(installDir(pkg), buildDir.path());
-		ctxt.emplace<ConfigurationContextItem>(config);
-		notifier.await(pkg->mirrors().first().install(ctxt));
-
-		m_installed.append(InstalledPackage{pkg, 0, config});
-		writeSettings();
+	// several dependents might ask for the same package at once
+	static SingleFlight<void> installs;
+	return installs.run(baseDir(pkg).absolutePath(), [self, pkg, config]()
+	{
+		// other ralph processes might be installing it as well, only the lock file tells us about them
+		return acquireLock(self->baseDir(pkg).absolutePath() + ".lock", "Waiting for another process installing %1..." % pkg->name(),
+						   s_installLockStaleTime)
+				.then([self, pkg, config](const std::shared_ptr<QLockFile> &lock, Notifier notifier)
+		{
+			{
+				const SettingsLock settingsLock(self->m_dir);
+				self->readSettings();
+			}
+			if (self->isInstalled(pkg)) {
+				lock->unlock();
+				notifier.status("%1 is already installed!" % pkg->name());
+				return makeReadyFuture();
+			}
+
+			notifier.status("Installing %1 into %2..." % pkg->name() % self->m_name);
+
+			// has to stay around until the installation has finished
+			std::shared_ptr<QTemporaryDir> buildDir = std::make_shared<QTemporaryDir>();
+
+			ActionContext ctxt;
+			ctxt.emplace<InstallContextItem>(self->installDir(pkg), buildDir->path());
+			ctxt.emplace<ConfigurationContextItem>(config);
+			return pkg->mirrors().first().install(ctxt).then([self, pkg, config, buildDir, lock]()
+			{
+				// others might have finished in the meantime
+				const SettingsLock settingsLock(self->m_dir);
+				self->readSettings();
+				self->m_installed.append(InstalledPackage{pkg, 0, config});
+				self->writeSettings();
+				lock->unlock();
+			});
+		});
 	});
 }
 Future<void> PackageGroup::remove(const Package *pkg)
 {
-	return async([this, pkg](Notifier notifier)
+	std::shared_ptr<PackageGroup> self = std::make_shared<PackageGroup>(*this);
+	return async([self, pkg](Notifier notifier)
 	{
-		readSettings();
-		if (!isInstalled(pkg)) {
+		const SettingsLock settingsLock(self->m_dir);
+		self->readSettings();
+		if (!self->isInstalled(pkg)) {
 			notifier.status("%1 is not installed!" % pkg->name());
 			return;
 		}
 
-		notifier.status("Removing %1 from %2..." % pkg->name() % m_name);
+		notifier.status("Removing %1 from %2..." % pkg->name() % self->m_name);
 
-		FS::remove(baseDir(pkg));
+		FS::remove(self->baseDir(pkg));
 
-		m_installed.erase(findInstalled(pkg));
-		writeSettings();
+		self->m_installed.erase(self->findInstalled(pkg));
+		self->writeSettings();
 	});
 }
 
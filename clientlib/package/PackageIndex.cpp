@@ -0,0 +1,427 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PackageIndex.h"
+
+#include <QDataStream>
+#include <QMap>
+#include <QPair>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "Package.h"
+#include "Version.h"
+
+namespace Ralph {
+namespace ClientLib {
+
+// bump the version whenever the layout or anything that is serialized into it changes
+static const quint32 s_magic = 0x524c5043; // "RLPC"
+static const quint32 s_version = 4;
+static const quint32 s_headerSize = 10 * 4;
+static const quint32 s_nameSize = 4 * 4;
+static const quint32 s_recordSize = 8 * 4;
+static const quint32 s_trigramSize = 3 * 4;
+
+PackageIndex::Record PackageIndex::Record::fromPackage(const QString &source, const QString &path, const Package *package)
+{
+	Record record{source, path, package->name().toLower(), package->version().toString(), QByteArray()};
+	QDataStream str(&record.data, QIODevice::WriteOnly);
+	str.setVersion(QDataStream::Qt_5_0);
+	str << *package;
+	return record;
+}
+Package *PackageIndex::Record::package() const
+{
+	Package *pkg = Package::createLazy(data);
+	if (!pkg) {
+		throw PackageIndexException(QString("Unable to read package '%1', the index might be corrupt") % name);
+	}
+	return pkg;
+}
+
+PackageIndex::PackageIndex() {}
+PackageIndex::~PackageIndex()
+{
+	close();
+	qDeleteAll(m_retired);
+}
+
+bool PackageIndex::open(const QString &filename)
+{
+	close();
+	m_file.setFileName(filename);
+	if (!m_file.open(QFile::ReadOnly) || m_file.size() < s_headerSize || m_file.size() > std::numeric_limits<quint32>::max()) {
+		m_file.close();
+		return false;
+	}
+	m_data = m_file.map(0, m_file.size());
+	if (!m_data) {
+		m_file.close();
+		return false;
+	}
+	m_size = quint32(m_file.size());
+
+	try {
+		if (read(0) != s_magic || read(4) != s_version) {
+			close();
+			return false;
+		}
+		QDataStream str(bytes(read(8), read(12)));
+		str.setVersion(QDataStream::Qt_5_0);
+		str >> m_timestamps >> m_revisions;
+		if (str.status() != QDataStream::Ok) {
+			close();
+			return false;
+		}
+
+		m_nameCount = read(16);
+		m_namesOffset = read(20);
+		m_recordCount = read(24);
+		m_recordsOffset = read(28);
+		m_trigramCount = read(32);
+		m_trigramsOffset = read(36);
+		// makes sure all entries can be read without further checks
+		if (m_nameCount > m_size / s_nameSize || m_recordCount > m_size / s_recordSize || m_trigramCount > m_size / s_trigramSize) {
+			close();
+			return false;
+		}
+		bytes(m_namesOffset, m_nameCount * s_nameSize);
+		bytes(m_recordsOffset, m_recordCount * s_recordSize);
+		bytes(m_trigramsOffset, m_trigramCount * s_trigramSize);
+	} catch (PackageIndexException &) {
+		close();
+		return false;
+	}
+	return true;
+}
+void PackageIndex::close()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	// somebody might still be holding on to them, and they might still need the mapping
+	for (const Package *pkg : m_materialized) {
+		try {
+			pkg->ensureLoaded();
+		} catch (Exception &) {
+			// will throw again on access, without touching the mapping
+		}
+		m_retired.push_back(pkg);
+	}
+	m_materialized.clear();
+	if (m_data) {
+		m_file.unmap(const_cast<uchar *>(m_data));
+		m_data = nullptr;
+	}
+	m_file.close();
+	m_size = m_nameCount = m_namesOffset = m_recordCount = m_recordsOffset = m_trigramCount = m_trigramsOffset = 0;
+	m_timestamps.clear();
+	m_revisions.clear();
+}
+
+qint64 PackageIndex::residentSize() const
+{
+	if (!m_data) {
+		return 0;
+	}
+#ifdef Q_OS_LINUX
+	// mappings always start at a page boundary, so we can ask for it as-is
+	const std::size_t pageSize = std::size_t(sysconf(_SC_PAGESIZE));
+	std::vector<unsigned char> pages((m_size + pageSize - 1) / pageSize);
+	if (mincore(const_cast<uchar *>(m_data), m_size, pages.data()) == 0) {
+		const qint64 resident = std::count_if(pages.cbegin(), pages.cend(), [](const unsigned char page) { return page & 1; });
+		return std::min<qint64>(resident * qint64(pageSize), m_size);
+	}
+#endif
+	return m_size;
+}
+
+void PackageIndex::write(const QString &filename, const QHash<QString, QDateTime> &timestamps, const QHash<QString, QString> &revisions,
+						 const QVector<Record> &records)
+{
+	QMap<QByteArray, QVector<const Record *>> byName;
+	for (const Record &record : records) {
+		byName[record.name.toUtf8()].append(&record);
+	}
+
+	QByteArray sourcesData;
+	{
+		QDataStream str(&sourcesData, QIODevice::WriteOnly);
+		str.setVersion(QDataStream::Qt_5_0);
+		str << timestamps << revisions;
+	}
+
+	// name indices are the position in byName, which is also the order of the name entries
+	QMap<quint32, QVector<quint32>> trigramPostings;
+	quint32 nameIndex = 0;
+	for (auto it = byName.cbegin(); it != byName.cend(); ++it, ++nameIndex) {
+		for (const quint32 trigram : NameSearch::trigrams(it.key())) {
+			trigramPostings[trigram].append(nameIndex);
+		}
+	}
+
+	const quint32 namesOffset = s_headerSize;
+	const quint32 recordsOffset = namesOffset + quint32(byName.size()) * s_nameSize;
+	const quint32 trigramsOffset = recordsOffset + quint32(records.size()) * s_recordSize;
+	const quint32 payloadOffset = trigramsOffset + quint32(trigramPostings.size()) * s_trigramSize;
+
+	QByteArray entries;
+	QByteArray recordEntries;
+	QByteArray trigramEntries;
+	QByteArray payload = sourcesData;
+	auto append32 = [](QByteArray &array, const quint32 value)
+	{
+		char buffer[4];
+		qToLittleEndian(value, reinterpret_cast<uchar *>(buffer));
+		array.append(buffer, 4);
+	};
+	auto appendBytes = [&payload, payloadOffset, &append32](QByteArray &array, const QByteArray &data)
+	{
+		append32(array, payloadOffset + quint32(payload.size()));
+		append32(array, quint32(data.size()));
+		payload.append(data);
+	};
+
+	quint32 recordIndex = 0;
+	for (auto it = byName.begin(); it != byName.end(); ++it) {
+		QVector<QPair<Version, const Record *>> versions;
+		for (const Record *record : it.value()) {
+			versions.append(qMakePair(Version::fromString(record->version), record));
+		}
+		std::stable_sort(versions.begin(), versions.end(), [](const QPair<Version, const Record *> &a, const QPair<Version, const Record *> &b)
+		{
+			return a.first < b.first;
+		});
+
+		appendBytes(entries, it.key());
+		append32(entries, recordIndex);
+		append32(entries, quint32(versions.size()));
+		recordIndex += quint32(versions.size());
+
+		for (const auto &version : versions) {
+			appendBytes(recordEntries, version.second->version.toUtf8());
+			appendBytes(recordEntries, version.second->data);
+			appendBytes(recordEntries, version.second->source.toUtf8());
+			appendBytes(recordEntries, version.second->path.toUtf8());
+		}
+	}
+
+	for (auto it = trigramPostings.cbegin(); it != trigramPostings.cend(); ++it) {
+		QByteArray list;
+		for (const quint32 index : it.value()) {
+			append32(list, index);
+		}
+		append32(trigramEntries, it.key());
+		appendBytes(trigramEntries, list);
+	}
+
+	QByteArray header;
+	append32(header, s_magic);
+	append32(header, s_version);
+	append32(header, payloadOffset); // the source timestamps are the first thing in the payload
+	append32(header, quint32(sourcesData.size()));
+	append32(header, quint32(byName.size()));
+	append32(header, namesOffset);
+	append32(header, quint32(records.size()));
+	append32(header, recordsOffset);
+	append32(header, quint32(trigramPostings.size()));
+	append32(header, trigramsOffset);
+
+	// written to a temporary file first, so that other processes never see a partially written index
+	QSaveFile file(filename);
+	if (!file.open(QFile::WriteOnly)) {
+		throw PackageIndexException(QString("Unable to write %1: %2") % filename % file.errorString());
+	}
+	file.write(header);
+	file.write(entries);
+	file.write(recordEntries);
+	file.write(trigramEntries);
+	file.write(payload);
+	if (!file.commit()) {
+		throw PackageIndexException(QString("Unable to write %1: %2") % filename % file.errorString());
+	}
+}
+
+QVector<QString> PackageIndex::names() const
+{
+	QVector<QString> out;
+	out.reserve(int(m_nameCount));
+	for (quint32 i = 0; i < m_nameCount; ++i) {
+		const quint32 entry = m_namesOffset + i * s_nameSize;
+		out.append(QString::fromUtf8(bytes(read(entry), read(entry + 4))));
+	}
+	return out;
+}
+QVector<PackageIndex::Record> PackageIndex::records(const QString &source) const
+{
+	QVector<Record> out;
+	const QByteArray sourceName = source.toUtf8();
+	for (quint32 i = 0; i < m_nameCount; ++i) {
+		const quint32 entry = m_namesOffset + i * s_nameSize;
+		const quint32 first = read(entry + 8);
+		const quint32 count = read(entry + 12);
+		for (quint32 j = first; j < first + count; ++j) {
+			const quint32 record = m_recordsOffset + j * s_recordSize;
+			if (bytes(read(record + 16), read(record + 20)) != sourceName) {
+				continue;
+			}
+			// deep copies, the records usually outlive the mapping
+			const QByteArray data = bytes(read(record + 8), read(record + 12));
+			out.append(Record{source,
+							  QString::fromUtf8(bytes(read(record + 24), read(record + 28))),
+							  QString::fromUtf8(bytes(read(entry), read(entry + 4))),
+							  QString::fromUtf8(bytes(read(record), read(record + 4))),
+							  QByteArray(data.constData(), data.size())});
+		}
+	}
+	return out;
+}
+QVector<const Package *> PackageIndex::find(const QString &name) const
+{
+	QVector<const Package *> out;
+	const qint64 index = findName(name.toUtf8());
+	if (index < 0) {
+		return out;
+	}
+	const quint32 entry = m_namesOffset + quint32(index) * s_nameSize;
+	const quint32 first = read(entry + 8);
+	const quint32 count = read(entry + 12);
+	for (quint32 i = first; i < first + count; ++i) {
+		out.append(materialize(i));
+	}
+	return out;
+}
+const Package *PackageIndex::get(const QString &name, const Version &version) const
+{
+	const qint64 index = findName(name.toUtf8());
+	if (index < 0) {
+		return nullptr;
+	}
+	const quint32 entry = m_namesOffset + quint32(index) * s_nameSize;
+	quint32 low = read(entry + 8);
+	quint32 high = low + read(entry + 12);
+	// versions are sorted, so only the records we compare with have their version parsed
+	while (low < high) {
+		const quint32 mid = low + (high - low) / 2;
+		const quint32 record = m_recordsOffset + mid * s_recordSize;
+		const Version candidate = Version::fromString(QString::fromUtf8(bytes(read(record), read(record + 4))));
+		if (candidate < version) {
+			low = mid + 1;
+		} else if (version < candidate) {
+			high = mid;
+		} else {
+			return materialize(mid);
+		}
+	}
+	return nullptr;
+}
+
+quint32 PackageIndex::nameCount() const
+{
+	return m_nameCount;
+}
+QByteArray PackageIndex::name(const quint32 index) const
+{
+	const quint32 entry = m_namesOffset + index * s_nameSize;
+	return bytes(read(entry), read(entry + 4));
+}
+QVector<quint32> PackageIndex::postings(const quint32 trigram) const
+{
+	// trigram entries are sorted by trigram
+	quint32 low = 0;
+	quint32 high = m_trigramCount;
+	while (low < high) {
+		const quint32 mid = low + (high - low) / 2;
+		const quint32 entry = m_trigramsOffset + mid * s_trigramSize;
+		const quint32 candidate = read(entry);
+		if (candidate < trigram) {
+			low = mid + 1;
+		} else if (trigram < candidate) {
+			high = mid;
+		} else {
+			const quint32 offset = read(entry + 4);
+			const quint32 size = read(entry + 8);
+			bytes(offset, size);
+			QVector<quint32> out;
+			out.reserve(int(size / 4));
+			for (quint32 i = 0; i + 4 <= size; i += 4) {
+				out.append(qFromLittleEndian<quint32>(m_data + offset + i));
+			}
+			return out;
+		}
+	}
+	return {};
+}
+
+quint32 PackageIndex::read(const quint32 offset) const
+{
+	if (offset > m_size || m_size - offset < 4) {
+		throw PackageIndexException("Out of bounds read in %1, it might be corrupt" % m_file.fileName());
+	}
+	return qFromLittleEndian<quint32>(m_data + offset);
+}
+QByteArray PackageIndex::bytes(const quint32 offset, const quint32 size) const
+{
+	if (offset > m_size || m_size - offset < size) {
+		throw PackageIndexException("Out of bounds read in %1, it might be corrupt" % m_file.fileName());
+	}
+	// no copy, the mapping stays valid until we are closed
+	return QByteArray::fromRawData(reinterpret_cast<const char *>(m_data + offset), int(size));
+}
+qint64 PackageIndex::findName(const QByteArray &name) const
+{
+	quint32 low = 0;
+	quint32 high = m_nameCount;
+	while (low < high) {
+		const quint32 mid = low + (high - low) / 2;
+		const quint32 entry = m_namesOffset + mid * s_nameSize;
+		const QByteArray candidate = bytes(read(entry), read(entry + 4));
+		if (candidate < name) {
+			low = mid + 1;
+		} else if (name < candidate) {
+			high = mid;
+		} else {
+			return mid;
+		}
+	}
+	return -1;
+}
+const Package *PackageIndex::materialize(const quint32 record) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (const Package *existing = m_materialized.value(record)) {
+		return existing;
+	}
+
+	const quint32 entry = m_recordsOffset + record * s_recordSize;
+	// only name and version are read now, the rest when it is first needed, straight from the mapping
+	const Package *pkg = Package::createLazy(bytes(read(entry + 8), read(entry + 12)));
+	if (!pkg) {
+		throw PackageIndexException("Unable to read package from %1, it might be corrupt" % m_file.fileName());
+	}
+	m_materialized.insert(record, pkg);
+	return pkg;
+}
+
+}
+}
@@ -0,0 +1,133 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <mutex>
+#include <vector>
+
+#include "Exception.h"
+#include "NameSearch.h"
+
+namespace Ralph {
+namespace ClientLib {
+class Package;
+class Version;
+
+DECLARE_EXCEPTION(PackageIndex);
+
+/**
+ * Read-only, memory mapped index of all packages of a database (cache.dat).
+ *
+ * Opening it only maps the file and checks the header, names are binary searched in the mapped
+ * memory and Package objects are only created for the records that are actually asked for.
+ *
+ * The names are also indexed by their trigrams for search(), see NameSearch.
+ *
+ * Every record also remembers the source and manifest it was read from, which allows rebuilding
+ * the index by only re-reading the manifests that changed and copying all other records as-is.
+ *
+ * Layout, all integers are 32 bit little endian:
+ *  - header: magic, format version, offset and size of the source timestamps and revisions,
+ *    number and offset of name entries, number and offset of record entries, number and offset
+ *    of trigram entries
+ *  - name entries, sorted by the UTF-8 bytes of the lowercase name: name offset and length,
+ *    index of the first record and number of records
+ *  - record entries, sorted by version within each name: offset and length of the version string,
+ *    the serialized Package, the source name and the manifest path
+ *  - trigram entries, sorted by trigram: the trigram, offset and size of the list of name indices
+ *  - the strings, serialized packages and lists of name indices referenced from the entries
+ */
+class PackageIndex : public NameSearch
+{
+public:
+	/// A serialized package, as stored in the index
+	struct Record
+	{
+		QString source;
+		QString path; ///< The manifest it was read from, relative to the source
+		QString name; ///< Lowercase
+		QString version;
+		QByteArray data;
+
+		static Record fromPackage(const QString &source, const QString &path, const Package *package);
+		Package *package() const;
+	};
+
+	explicit PackageIndex();
+	~PackageIndex() override;
+
+	/// Maps filename, returns false if it does not exist or is of a different format
+	bool open(const QString &filename);
+	void close();
+	bool isOpen() const { return m_data != nullptr; }
+
+	static void write(const QString &filename, const QHash<QString, QDateTime> &timestamps, const QHash<QString, QString> &revisions,
+					  const QVector<Record> &records);
+
+	/// The lastUpdated() of each source at the time the index was written
+	QHash<QString, QDateTime> sourceTimestamps() const { return m_timestamps; }
+	/// The PackageSource::revision() of each source at the time the index was written
+	QHash<QString, QString> sourceRevisions() const { return m_revisions; }
+	/// Copies of all records that were read from source
+	QVector<Record> records(const QString &source) const;
+
+	quint32 recordCount() const { return m_recordCount; }
+	/// Size of the mapping
+	qint64 size() const { return m_size; }
+	/// How much of the mapping is currently in memory, size() if that can not be determined
+	qint64 residentSize() const;
+
+	/// All (lowercase) names in the index
+	QVector<QString> names() const;
+	/// All versions of a package, name has to be lowercase
+	QVector<const Package *> find(const QString &name) const;
+	const Package *get(const QString &name, const Version &version) const;
+
+private:
+	QFile m_file;
+	const uchar *m_data = nullptr;
+	quint32 m_size = 0;
+	quint32 m_nameCount = 0;
+	quint32 m_namesOffset = 0;
+	quint32 m_recordCount = 0;
+	quint32 m_recordsOffset = 0;
+	quint32 m_trigramCount = 0;
+	quint32 m_trigramsOffset = 0;
+	QHash<QString, QDateTime> m_timestamps;
+	QHash<QString, QString> m_revisions;
+
+	// records are materialized on first access and then kept around, since we hand out pointers to them
+	mutable std::mutex m_mutex;
+	mutable QHash<quint32, const Package *> m_materialized;
+	std::vector<const Package *> m_retired;
+
+	quint32 nameCount() const override;
+	QByteArray name(const quint32 index) const override;
+	QVector<quint32> postings(const quint32 trigram) const override;
+
+	quint32 read(const quint32 offset) const;
+	QByteArray bytes(const quint32 offset, const quint32 size) const;
+	/// Index of the name entry for name, or -1
+	qint64 findName(const QByteArray &name) const;
+	const Package *materialize(const quint32 record) const;
+};
+
+}
+}
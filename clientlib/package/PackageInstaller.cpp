@@ -0,0 +1,227 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PackageInstaller.h"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "task/Executor.h"
+#include "Exception.h"
+#include "Package.h"
+
+namespace Ralph {
+namespace ClientLib {
+
+namespace {
+struct Node
+{
+	const Package *pkg;
+	std::vector<std::size_t> dependents;
+	int waitingFor = 0;
+	int chain = 1; ///< Length of the longest chain of dependents, including this package
+	bool started = false;
+	Promise<void> promise;
+};
+struct State
+{
+	State(const PackageInstaller::InstallFunction &i, const PackageConfiguration &c) : install(i), config(c) {}
+
+	// every install refers to the group in here, so it has to stay around until all of them are done
+	const PackageInstaller::InstallFunction install;
+	const PackageConfiguration config;
+	int maxConcurrent = 1;
+
+	std::mutex mutex;
+	std::vector<Node> nodes;
+	std::vector<std::size_t> ready; ///< Heap, longest chain on top
+	int running = 0;
+	std::size_t remaining = 0;
+	QString failed; ///< The first package that failed, nothing is started once set
+	std::exception_ptr exception; ///< Of failed
+	Promise<void> done;
+
+	std::function<bool(std::size_t, std::size_t)> shorterChain() const
+	{
+		return [this](const std::size_t a, const std::size_t b) { return nodes.at(a).chain < nodes.at(b).chain; };
+	}
+};
+
+void finishIfDone(const std::shared_ptr<State> &state, const std::size_t completed)
+{
+	bool allDone;
+	std::exception_ptr exception;
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->remaining -= completed;
+		allDone = state->remaining == 0;
+		exception = state->exception;
+	}
+	if (allDone) {
+		Private::fulfil(state->done, [exception]()
+		{
+			if (exception) {
+				std::rethrow_exception(exception);
+			}
+		});
+	}
+}
+
+void startReady(const std::shared_ptr<State> &state);
+
+void finished(const std::shared_ptr<State> &state, const std::size_t index, Future<void> future)
+{
+	Node &node = state->nodes.at(index);
+	std::exception_ptr exception;
+	try {
+		future.result();
+	} catch (...) {
+		exception = std::current_exception();
+	}
+
+	std::vector<std::size_t> abandoned;
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		--state->running;
+		if (exception) {
+			if (state->failed.isNull()) {
+				state->failed = node.pkg->name();
+				state->exception = exception;
+			}
+			for (std::size_t i = 0; i < state->nodes.size(); ++i) {
+				if (!state->nodes.at(i).started) {
+					state->nodes.at(i).started = true;
+					abandoned.push_back(i);
+				}
+			}
+			state->ready.clear();
+		} else {
+			for (const std::size_t dependent : node.dependents) {
+				if (--state->nodes.at(dependent).waitingFor == 0) {
+					state->ready.push_back(dependent);
+					std::push_heap(state->ready.begin(), state->ready.end(), state->shorterChain());
+				}
+			}
+		}
+	}
+
+	if (exception) {
+		node.promise.reportException(exception);
+	} else {
+		node.promise.reportFinished();
+	}
+	for (const std::size_t i : abandoned) {
+		const QString reason = "%1 was not installed because %2 failed" % state->nodes.at(i).pkg->name() % state->failed;
+		state->nodes.at(i).promise.reportException(std::make_exception_ptr(Exception(reason)));
+	}
+	finishIfDone(state, abandoned.size() + 1);
+	startReady(state);
+}
+
+void startReady(const std::shared_ptr<State> &state)
+{
+	std::vector<std::size_t> toStart;
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		while (state->failed.isNull() && state->running < state->maxConcurrent && !state->ready.empty()) {
+			std::pop_heap(state->ready.begin(), state->ready.end(), state->shorterChain());
+			const std::size_t index = state->ready.back();
+			state->ready.pop_back();
+			state->nodes.at(index).started = true;
+			++state->running;
+			toStart.push_back(index);
+		}
+	}
+
+	for (const std::size_t index : toStart) {
+		Node &node = state->nodes.at(index);
+		node.promise.reportStarted();
+		// canceling the installer reaches us through the promises of the packages
+		Future<void> future = node.promise.isCancelRequested()
+				? async([]() { throw CanceledException("The operation was canceled"); })
+				: state->install(node.pkg, state->config);
+		node.promise.adopt(future);
+		future.addContinuation([state, index, future]() { finished(state, index, future); });
+	}
+}
+}
+
+PackageInstaller::PackageInstaller(const PackageGroup &group, const PackageConfiguration &config)
+	: m_config(config), m_maxConcurrent(int(Executor::defaultThreadCount())),
+	  m_install([group](const Package *pkg, const PackageConfiguration &c) mutable { return group.install(pkg, c); }) {}
+
+Future<void> PackageInstaller::install(const DependencyResolver::Resolution &resolution)
+{
+	std::shared_ptr<State> state = std::make_shared<State>(m_install, m_config);
+	state->maxConcurrent = std::max(1, m_maxConcurrent);
+	state->remaining = std::size_t(resolution.packages.size());
+
+	QHash<const Package *, std::size_t> indices;
+	for (const Package *pkg : resolution.packages) {
+		indices.insert(pkg, state->nodes.size());
+		state->nodes.emplace_back();
+		state->nodes.back().pkg = pkg;
+	}
+	for (std::size_t i = 0; i < state->nodes.size(); ++i) {
+		for (const Package *dependency : resolution.dependencies.value(state->nodes.at(i).pkg)) {
+			// dependencies come first, so one that comes later closes a cycle, and ones that are
+			// not part of the resolution at all are expected to be installed already
+			if (indices.contains(dependency) && indices.value(dependency) < i) {
+				state->nodes.at(indices.value(dependency)).dependents.push_back(i);
+				++state->nodes.at(i).waitingFor;
+			}
+		}
+	}
+
+	m_packages.clear();
+	// dependents always come later, so going backwards sees them before their dependencies
+	for (std::size_t i = state->nodes.size(); i-- > 0;) {
+		Node &node = state->nodes.at(i);
+		for (const std::size_t dependent : node.dependents) {
+			node.chain = std::max(node.chain, state->nodes.at(dependent).chain + 1);
+		}
+		if (node.waitingFor == 0) {
+			state->ready.push_back(i);
+		}
+		m_packages.insert(node.pkg, node.promise.future());
+		state->done.adopt(node.promise.future());
+	}
+	std::make_heap(state->ready.begin(), state->ready.end(), state->shorterChain());
+
+	return async([state](Notifier notifier)
+	{
+		if (state->nodes.empty()) {
+			return;
+		}
+		startReady(state);
+		notifier.await(state->done.future());
+	});
+}
+
+Future<void> PackageInstaller::package(const Package *pkg) const
+{
+	const auto it = m_packages.constFind(pkg);
+	if (it == m_packages.constEnd()) {
+		const QString name = pkg->name();
+		return async([name]() { throw Exception("%1 is not part of this installation" % name); });
+	}
+	return *it;
+}
+
+}
+}
@@ -0,0 +1,68 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QVector>
+#include <functional>
+#include <memory>
+
+#include "task/Task.h"
+#include "DependencyResolver.h"
+#include "PackageConfiguration.h"
+#include "PackageGroup.h"
+
+namespace Ralph {
+namespace ClientLib {
+
+/**
+ * Installs a resolved dependency graph, with as many packages at the same time as possible.
+ *
+ * A package is started as soon as all of its dependencies are installed. If more packages are
+ * ready than may run at once, the ones with the longest chain of packages waiting on them go
+ * first, since that chain is what bounds the total time.
+ *
+ * If a package fails nothing else is started, and everything that has not been started fails
+ * as well.
+ */
+class PackageInstaller
+{
+public:
+	using InstallFunction = std::function<Future<void>(const Package *pkg, const PackageConfiguration &config)>;
+
+	explicit PackageInstaller(const PackageGroup &group, const PackageConfiguration &config);
+
+	/// Defaults to the number of Executor threads
+	void setMaxConcurrent(const int max) { m_maxConcurrent = max; }
+	/// Installs a single package, defaults to PackageGroup::install of the group
+	void setInstallFunction(const InstallFunction &install) { m_install = install; }
+
+	/// Installs everything in resolution.packages, which has to list dependencies before their dependents
+	Future<void> install(const DependencyResolver::Resolution &resolution);
+
+	/// Finishes once pkg has been installed by the last install(), for watching the packages one by one. Fails if pkg was not part of it.
+	Future<void> package(const Package *pkg) const;
+
+private:
+	PackageConfiguration m_config;
+	int m_maxConcurrent;
+	InstallFunction m_install;
+
+	QHash<const Package *, Future<void>> m_packages;
+};
+
+}
+}
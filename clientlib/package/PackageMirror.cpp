@@ -15,6 +15,9 @@
 
 #include "PackageMirror.h"
 
+#include <QDataStream>
+#include <QJsonDocument>
+
 #include "Json.h"
 #include "FileSystem.h"
 #include "Requirement.h"
@@ -59,6 +62,38 @@ PackageMirror PackageMirror::fromJson(const QJsonObject &obj)
 	return candidate;
 }
 
+QDataStream &operator<<(QDataStream &stream, const PackageMirror &mirror)
+{
+	stream << bool(mirror.requirement());
+	if (mirror.requirement()) {
+		mirror.requirement()->write(stream);
+	}
+	stream << quint32(mirror.steps().size());
+	for (const std::shared_ptr<InstallationStep> &step : mirror.steps()) {
+		// steps have no binary form of their own, but they are few and small
+		const QJsonValue json = step->toJson();
+		stream << step->type() << (json.isObject() ? QJsonDocument(json.toObject()).toJson(QJsonDocument::Compact) : QByteArray());
+	}
+	return stream;
+}
+QDataStream &operator>>(QDataStream &stream, PackageMirror &mirror)
+{
+	bool hasRequirement;
+	stream >> hasRequirement;
+	mirror.setRequirement(hasRequirement ? Requirement::read(stream) : RequirementPtr());
+	quint32 count;
+	stream >> count;
+	QVector<std::shared_ptr<InstallationStep>> steps;
+	for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+		QString type;
+		QByteArray json;
+		stream >> type >> json;
+		steps.append(std::shared_ptr<InstallationStep>(InstallationStep::create(type, QJsonDocument::fromJson(json).object())));
+	}
+	mirror.setSteps(steps);
+	return stream;
+}
+
 Future<void> PackageMirror::install(const ActionContext &ctxt) const
 {
 	return async([this, ctxt](Notifier notifier)
@@ -21,6 +21,7 @@
 #include "task/Task.h"
 
 QT_BEGIN_NAMESPACE
+class QDataStream;
 class QDir;
 QT_END_NAMESPACE
 
@@ -53,5 +54,9 @@ private:
 	QVector<std::shared_ptr<InstallationStep>> m_steps;
 };
 
+// binary form for the package cache
+QDataStream &operator<<(QDataStream &stream, const PackageMirror &mirror);
+QDataStream &operator>>(QDataStream &stream, PackageMirror &mirror);
+
 }
 }
@@ -15,10 +15,19 @@
 
 #include "PackageSource.h"
 
+#include <QJsonDocument>
+#include <QStringList>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
 #include "Json.h"
+#include "FileSystem.h"
 #include "project/Project.h"
 #include "Functional.h"
 #include "task/Task.h"
+#include "task/Executor.h"
+#include "future/FutureCombinators.h"
 #include "git/GitRepo.h"
 
 namespace Ralph {
@@ -130,6 +139,45 @@ PackageSource *PackageSource::fromString(const QString &value)
 	}
 }
 
+Future<QVector<PackageSource::Manifest>> PackageSource::manifests() const
+{
+	return packages().then([](const QVector<const Package *> &pkgs)
+	{
+		return Functional::map2<QVector<Manifest>>(pkgs, [](const Package *pkg) { return Manifest{QString(), pkg}; });
+	});
+}
+Future<QVector<PackageSource::Manifest>> PackageSource::manifests(const QVector<QString> &) const
+{
+	return async([]() -> QVector<Manifest> { throw Exception("This source can not read single manifests"); });
+}
+PackageSource::ParseStats &PackageSource::ParseStats::operator+=(const ParseStats &other)
+{
+	manifests += other.manifests;
+	bytes += other.bytes;
+	parseTime += other.parseTime;
+	fromJsonTime += other.fromJsonTime;
+	return *this;
+}
+PackageSource::ParseStats PackageSource::parseStats() const
+{
+	std::lock_guard<std::mutex> lock(m_parseStatsMutex);
+	return m_parseStats;
+}
+void PackageSource::addParseStats(const ParseStats &stats) const
+{
+	std::lock_guard<std::mutex> lock(m_parseStatsMutex);
+	m_parseStats += stats;
+}
+
+Future<QString> PackageSource::revision() const
+{
+	return makeReadyFuture(QString());
+}
+Future<QVector<QString>> PackageSource::changedManifests(const QString &) const
+{
+	return async([]() -> QVector<QString> { throw Exception("This source can not tell what changed"); });
+}
+
 QJsonObject PackageSource::toJson() const
 {
 	return QJsonObject({
@@ -231,14 +279,98 @@ GitRepoPackageSource::GitRepoPackageSource()
 	: BaseGitPackageSource(GitRepo) {}
 
 Future<QVector<const Package *> > GitRepoPackageSource::packages() const
+{
+	return manifests().then([](const QVector<Manifest> &all)
+	{
+		return Functional::map2<QVector<const Package *>>(all, [](const Manifest &manifest) { return manifest.package; });
+	});
+}
+Future<QVector<PackageSource::Manifest>> GitRepoPackageSource::manifests() const
 {
 	return async([this]()
 	{
-		const auto files = basePath().entryInfoList(QStringList() << "*.json", QDir::Files | QDir::NoSymLinks | QDir::Readable);
-		return Functional::map2<QVector<const Package *>>(files, [](const QFileInfo &file)
+		return basePath().entryList(QStringList() << "*.json", QDir::Files | QDir::NoSymLinks | QDir::Readable).toVector();
+	}).then([this](const QVector<QString> &files)
+	{
+		return manifests(files);
+	});
+}
+Future<QVector<PackageSource::Manifest>> GitRepoPackageSource::manifests(const QVector<QString> &paths) const
+{
+	struct Parsed
+	{
+		QVector<Manifest> manifests;
+		QStringList errors;
+		ParseStats stats;
+	};
+
+	// parsing is cpu bound, a few chunks per thread keep all threads busy even if some manifests are much larger
+	const int chunkCount = int(Executor::instance()->threadCount()) * 4;
+	const int chunkSize = std::max(1, (paths.size() + chunkCount - 1) / chunkCount);
+	QVector<Future<Parsed>> chunks;
+	for (int start = 0; start < paths.size(); start += chunkSize) {
+		const QVector<QString> chunk = paths.mid(start, chunkSize);
+		chunks.append(async([this, chunk]()
 		{
-			return Package::fromJson(Json::ensureDocument(file.absoluteFilePath()));
-		});
+			Parsed parsed;
+			for (const QString &path : chunk) {
+				// manifests are only looked for at the top level, see manifests()
+				if (path.contains('/') || !path.endsWith(".json") || !basePath().exists(path)) {
+					continue;
+				}
+				try {
+					using Clock = std::chrono::steady_clock;
+					const QByteArray data = FS::read(basePath().absoluteFilePath(path));
+					const Clock::time_point start = Clock::now();
+					const QJsonDocument doc = Json::ensureDocument(data);
+					const Clock::time_point parsedAt = Clock::now();
+					parsed.manifests.append(Manifest{path, Package::fromJson(doc)});
+					parsed.stats += ParseStats{1, data.size(),
+							std::chrono::duration_cast<std::chrono::microseconds>(parsedAt - start).count(),
+							std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - parsedAt).count()};
+				} catch (Exception &e) {
+					parsed.errors.append(path + ": " + e.cause());
+				}
+			}
+			return parsed;
+		}));
+	}
+
+	// chunks are merged in order, so the result is the same as reading the files one by one
+	return whenAll(chunks).then([this](const QVector<Parsed> &results)
+	{
+		QVector<Manifest> out;
+		QStringList errors;
+		ParseStats stats;
+		for (const Parsed &result : results) {
+			out += result.manifests;
+			errors += result.errors;
+			stats += result.stats;
+		}
+		addParseStats(stats);
+		if (!errors.isEmpty()) {
+			for (const Manifest &manifest : out) {
+				delete manifest.package;
+			}
+			throw Exception("Unable to read %1 manifest(s):\n%2" % QString::number(errors.size()) % errors.join('\n'));
+		}
+		return out;
+	});
+}
+Future<QString> GitRepoPackageSource::revision() const
+{
+	return Git::GitRepo::open(basePath()).then([](Git::GitRepo *repo)
+	{
+		std::unique_ptr<Git::GitRepo> owner(repo);
+		return repo->head();
+	});
+}
+Future<QVector<QString>> GitRepoPackageSource::changedManifests(const QString &since) const
+{
+	return Git::GitRepo::open(basePath()).then([since](Git::GitRepo *repo)
+	{
+		std::unique_ptr<Git::GitRepo> owner(repo);
+		return Functional::filter(repo->changedFiles(since, "HEAD"), [](const QString &file) { return file.endsWith(".json"); });
 	});
 }
 Future<void> GitRepoPackageSource::update()
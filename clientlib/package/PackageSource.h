@@ -18,6 +18,7 @@
 #include <QUrl>
 #include <QDir>
 #include <QDateTime>
+#include <mutex>
 
 #include "task/Task.h"
 
@@ -63,16 +64,49 @@ public:
 	virtual Future<QVector<const Package *>> packages() const = 0;
 	virtual Future<void> update() = 0;
 
+	// incremental access, used by PackageDatabase to only re-read what changed
+	struct Manifest
+	{
+		QString path; ///< Relative to basePath()
+		const Package *package;
+	};
+	/// All packages with the manifests they were read from, by default packages() without paths
+	virtual Future<QVector<Manifest>> manifests() const;
+	/// Only the given manifests, ones that do not exist (anymore) are skipped
+	virtual Future<QVector<Manifest>> manifests(const QVector<QString> &paths) const;
+	/// What manifests() currently reflects (a commit for git based sources), empty if the source can not tell
+	virtual Future<QString> revision() const;
+	/// Manifests that were added, modified or removed since revision, fails if that can not be determined
+	virtual Future<QVector<QString>> changedManifests(const QString &since) const;
+
+	/// What reading manifests has cost so far, see PackageDatabase::stats
+	struct ParseStats
+	{
+		int manifests = 0;
+		qint64 bytes = 0;
+		qint64 parseTime = 0; ///< Microseconds spent parsing JSON
+		qint64 fromJsonTime = 0; ///< Microseconds spent in Package::fromJson
+
+		ParseStats &operator+=(const ParseStats &other);
+	};
+	ParseStats parseStats() const;
+
 	// internal
 	QDir basePath() const { return m_basePath; }
 	/// @internal For usage by PackageDatabase only
 	void setBasePath(const QDir &dir) { m_basePath = dir; }
 
+protected:
+	void addParseStats(const ParseStats &stats) const;
+
 private:
 	const SourceType m_type;
 	QString m_name;
 	QDir m_basePath;
 	QDateTime m_lastUpdated;
+
+	mutable std::mutex m_parseStatsMutex;
+	mutable ParseStats m_parseStats;
 };
 
 class BaseGitPackageSource : public PackageSource
@@ -150,6 +184,11 @@ public:
 
 	Future<QVector<const Package *>> packages() const override;
 	Future<void> update() override;
+
+	Future<QVector<Manifest>> manifests() const override;
+	Future<QVector<Manifest>> manifests(const QVector<QString> &paths) const override;
+	Future<QString> revision() const override;
+	Future<QVector<QString>> changedManifests(const QString &since) const override;
 };
 
 }
@@ -15,6 +15,8 @@
 
 #include "ProjectLockFile.h"
 
+#include <QFile>
+
 #include "Version.h"
 #include "Json.h"
 #include "package/Package.h"
@@ -36,6 +38,16 @@ void ProjectLockFile::setPackage(const Package *pkg, const PackageGroup *group)
 	m_groups[pkg->name()] = group->name();
 	write();
 }
+void ProjectLockFile::setPackages(const QVector<const Package *> &packages, const PackageGroup *group)
+{
+	m_versions.clear();
+	m_groups.clear();
+	for (const Package *pkg : packages) {
+		m_versions[pkg->name()] = pkg->version().toString();
+		m_groups[pkg->name()] = group->name();
+	}
+	write();
+}
 Version ProjectLockFile::getVersion(const QString &name) const
 {
 	return Version::fromString(m_versions[name]);
@@ -48,6 +60,14 @@ bool ProjectLockFile::contains(const QString &name) const
 {
 	return m_versions.contains(name);
 }
+QHash<QString, Version> ProjectLockFile::versions() const
+{
+	QHash<QString, Version> out;
+	for (auto it = m_versions.cbegin(); it != m_versions.cend(); ++it) {
+		out.insert(it.key().toLower(), Version::fromString(it.value()));
+	}
+	return out;
+}
 
 void ProjectLockFile::write() const
 {
@@ -58,6 +78,10 @@ void ProjectLockFile::write() const
 }
 void ProjectLockFile::read()
 {
+	// nothing has been resolved yet
+	if (!QFile::exists(filename())) {
+		return;
+	}
 	const QJsonObject obj = Json::ensureObject(Json::ensureDocument(filename()));
 	m_versions = Json::ensureIsHashOf<QString>(obj, "versions");
 	m_groups = Json::ensureIsHashOf<QString>(obj, "groups");
@@ -16,6 +16,7 @@
 #pragma once
 
 #include <QHash>
+#include <QVector>
 
 class QJsonObject;
 
@@ -32,9 +33,13 @@ public:
 	explicit ProjectLockFile(const Project *project);
 
 	void setPackage(const Package *pkg, const PackageGroup *group);
+	/// Replaces everything with the result of a resolution, which is only written once
+	void setPackages(const QVector<const Package *> &packages, const PackageGroup *group);
 	Version getVersion(const QString &name) const;
 	QString getGroup(const QString &name) const;
 	bool contains(const QString &name) const;
+	/// All locked versions, by lowercase name
+	QHash<QString, Version> versions() const;
 
 	void write() const;
 	void read();
@@ -33,7 +33,7 @@ namespace Archive {
 
 Future<void> extract(const QString &filename, const QDir &destination)
 {
-	return async([filename, destination](Notifier notifier)
+	return async(Resource::Disk, [filename, destination](Notifier notifier)
 	{
 		const QMimeType mimetype = QMimeDatabase().mimeTypeForFile(filename);
 
@@ -0,0 +1,180 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Executor.h"
+
+#include <QtGlobal>
+
+namespace Ralph {
+namespace ClientLib {
+
+// the executor and queue index of the current thread, if it is a worker thread
+static thread_local Executor *t_executor = nullptr;
+static thread_local std::size_t t_workerIndex = 0;
+
+static std::atomic<std::size_t> s_defaultThreadCount{0};
+
+Executor::Executor(const std::size_t threadCount)
+{
+	for (std::size_t i = 0; i < std::max<std::size_t>(threadCount, 1); ++i) {
+		m_workers.push_back(std::make_unique<Worker>());
+	}
+	// only start the threads once all queues exist, since they immediately start stealing
+	for (std::size_t i = 0; i < m_workers.size(); ++i) {
+		m_workers.at(i)->thread = std::thread([this, i]()
+		{
+			t_executor = this;
+			t_workerIndex = i;
+			helpUntil([this]() { return m_stopping.load(); });
+		});
+	}
+}
+Executor::~Executor()
+{
+	m_stopping = true;
+	wake();
+	for (const std::unique_ptr<Worker> &worker : m_workers) {
+		worker->thread.join();
+	}
+}
+
+Executor *Executor::instance()
+{
+	// intentionally leaked, tasks that are still running on exit should not race with static destruction
+	static Executor *executor = new Executor(defaultThreadCount());
+	return executor;
+}
+
+std::size_t Executor::defaultThreadCount()
+{
+	if (s_defaultThreadCount > 0) {
+		return s_defaultThreadCount;
+	}
+	bool ok = false;
+	const int fromEnvironment = qEnvironmentVariableIntValue("RALPH_THREADS", &ok);
+	if (ok && fromEnvironment > 0) {
+		return std::size_t(fromEnvironment);
+	}
+	return std::max(std::thread::hardware_concurrency(), 1u);
+}
+void Executor::setDefaultThreadCount(const std::size_t count)
+{
+	s_defaultThreadCount = count;
+}
+
+void Executor::submit(Job &&job)
+{
+	if (t_executor == this) {
+		Worker *worker = m_workers.at(t_workerIndex).get();
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		worker->jobs.push_back(std::move(job));
+	} else {
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		m_shared.push_back(std::move(job));
+	}
+	// any thread will do, whoever wakes up runs the job
+	notify(false);
+}
+
+void Executor::helpUntil(const std::function<bool()> &done)
+{
+	while (true) {
+		// read the epoch before checking for work, otherwise we might miss a wake() in between
+		const std::uint64_t epoch = m_epoch;
+		if (done()) {
+			return;
+		}
+		if (runOne()) {
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		++m_sleeping;
+		m_sleepCondition.wait(lock, [this, epoch]() { return m_epoch != epoch; });
+		--m_sleeping;
+	}
+}
+void Executor::wake()
+{
+	notify(true);
+}
+void Executor::notify(const bool all)
+{
+	bool anyoneSleeping;
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		++m_epoch;
+		anyoneSleeping = m_sleeping > 0;
+	}
+	// avoids the syscall in the common case of all threads being busy
+	if (!anyoneSleeping) {
+		return;
+	}
+	if (all) {
+		m_sleepCondition.notify_all();
+	} else {
+		m_sleepCondition.notify_one();
+	}
+}
+
+bool Executor::runOne()
+{
+	Job job;
+	if (popLocal(job) || popShared(job) || steal(job)) {
+		job();
+		return true;
+	}
+	return false;
+}
+bool Executor::popLocal(Job &job)
+{
+	if (t_executor != this) {
+		return false;
+	}
+	Worker *worker = m_workers.at(t_workerIndex).get();
+	std::lock_guard<std::mutex> lock(worker->mutex);
+	if (worker->jobs.empty()) {
+		return false;
+	}
+	job = std::move(worker->jobs.back());
+	worker->jobs.pop_back();
+	return true;
+}
+bool Executor::popShared(Job &job)
+{
+	std::lock_guard<std::mutex> lock(m_sharedMutex);
+	if (m_shared.empty()) {
+		return false;
+	}
+	job = std::move(m_shared.front());
+	m_shared.pop_front();
+	return true;
+}
+bool Executor::steal(Job &job)
+{
+	const std::size_t start = t_executor == this ? t_workerIndex + 1 : 0;
+	for (std::size_t i = 0; i < m_workers.size(); ++i) {
+		Worker *victim = m_workers.at((start + i) % m_workers.size()).get();
+		std::lock_guard<std::mutex> lock(victim->mutex);
+		if (!victim->jobs.empty()) {
+			job = std::move(victim->jobs.front());
+			victim->jobs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+}
+}
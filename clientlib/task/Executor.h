@@ -0,0 +1,91 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Ralph {
+namespace ClientLib {
+
+/**
+ * Work-stealing thread pool that runs everything started through async().
+ *
+ * Every worker has its own queue, jobs submitted from a worker go into that queue and are
+ * run LIFO, jobs submitted from other threads go into a shared queue. Idle workers steal from
+ * the front of the queues of other workers.
+ *
+ * Threads waiting for a future (see helpUntil) execute queued jobs instead of sleeping, which
+ * means that a chain of nested awaits never needs more than one thread.
+ */
+class Executor
+{
+public:
+	using Job = std::function<void()>;
+
+	explicit Executor(const std::size_t threadCount);
+	~Executor();
+
+	/// The process-wide executor, created with defaultThreadCount() threads on first use
+	static Executor *instance();
+
+	/// Defaults to the RALPH_THREADS environment variable, or the number of cores if not set
+	static std::size_t defaultThreadCount();
+	/// Has to be called before the first task is started to have any effect
+	static void setDefaultThreadCount(const std::size_t count);
+
+	std::size_t threadCount() const { return m_workers.size(); }
+
+	void submit(Job &&job);
+
+	/// Runs queued jobs on the calling thread until done returns true
+	void helpUntil(const std::function<bool()> &done);
+	/// Wakes all threads sleeping in helpUntil so that they re-check their condition
+	void wake();
+
+private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+		std::thread thread;
+	};
+	std::vector<std::unique_ptr<Worker>> m_workers;
+
+	std::mutex m_sharedMutex;
+	std::deque<Job> m_shared;
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_sleepCondition;
+	std::atomic<std::uint64_t> m_epoch{0};
+	std::size_t m_sleeping = 0;
+	std::atomic<bool> m_stopping{false};
+
+	void notify(const bool all);
+	bool runOne();
+	bool popLocal(Job &job);
+	bool popShared(Job &job);
+	bool steal(Job &job);
+};
+
+}
+}
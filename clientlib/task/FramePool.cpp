@@ -0,0 +1,107 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FramePool.h"
+
+#include <array>
+#include <vector>
+
+namespace Ralph {
+namespace ClientLib {
+namespace Private {
+
+namespace {
+constexpr std::size_t granularity = 64;
+constexpr std::size_t classes = 16; // up to 1 KiB
+constexpr std::size_t maxCachedPerClass = 256;
+
+std::size_t sizeClass(const std::size_t size)
+{
+	return (size + granularity - 1) / granularity - 1;
+}
+
+struct ThreadCache
+{
+	std::array<std::vector<void *>, classes> freeLists;
+
+	~ThreadCache()
+	{
+		for (const std::vector<void *> &list : freeLists) {
+			for (void *block : list) {
+				::operator delete(block);
+			}
+		}
+	}
+};
+
+// blocks may be freed on a different thread than they were allocated on, they then simply move to that thread's cache.
+// the pointers are trivially destructible, so they stay usable while other thread_locals are destroyed on thread exit
+thread_local ThreadCache *t_cache = nullptr;
+thread_local bool t_exiting = false;
+struct CacheOwner
+{
+	~CacheOwner()
+	{
+		delete t_cache;
+		t_cache = nullptr;
+		t_exiting = true;
+	}
+};
+thread_local CacheOwner t_owner;
+
+ThreadCache *cache()
+{
+	if (!t_cache && !t_exiting) {
+		static_cast<void>(&t_owner); // makes sure the cache gets cleaned up
+		t_cache = new ThreadCache;
+	}
+	return t_cache;
+}
+}
+
+void *FramePool::allocate(const std::size_t size)
+{
+	const std::size_t index = sizeClass(size);
+	ThreadCache *threadCache = cache();
+	if (index >= classes || !threadCache) {
+		return ::operator new(size);
+	}
+	std::vector<void *> &list = threadCache->freeLists[index];
+	if (list.empty()) {
+		return ::operator new((index + 1) * granularity);
+	}
+	void *block = list.back();
+	list.pop_back();
+	return block;
+}
+void FramePool::deallocate(void *ptr, const std::size_t size)
+{
+	const std::size_t index = sizeClass(size);
+	ThreadCache *threadCache = cache();
+	if (index >= classes || !threadCache) {
+		::operator delete(ptr);
+		return;
+	}
+	std::vector<void *> &list = threadCache->freeLists[index];
+	if (list.size() >= maxCachedPerClass) {
+		::operator delete(ptr);
+		return;
+	}
+	list.push_back(ptr);
+}
+
+}
+}
+}
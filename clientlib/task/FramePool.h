@@ -0,0 +1,60 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace Ralph {
+namespace ClientLib {
+namespace Private {
+
+/**
+ * Recycles the memory of small, short-lived objects like task frames.
+ *
+ * Blocks are grouped into size classes and cached per thread, so allocating and freeing is
+ * just popping and pushing a free list. Bigger blocks go straight to operator new.
+ */
+class FramePool
+{
+public:
+	static void *allocate(const std::size_t size);
+	static void deallocate(void *ptr, const std::size_t size);
+};
+
+/// Allocator for std::allocate_shared that puts both the object and the control block into a FramePool block
+template <typename T>
+class PoolAllocator
+{
+public:
+	using value_type = T;
+
+	PoolAllocator() = default;
+	template <typename U>
+	PoolAllocator(const PoolAllocator<U> &) {}
+
+	T *allocate(const std::size_t n) { return static_cast<T *>(FramePool::allocate(n * sizeof(T))); }
+	void deallocate(T *ptr, const std::size_t n) { FramePool::deallocate(ptr, n * sizeof(T)); }
+
+	template <typename U>
+	bool operator==(const PoolAllocator<U> &) const { return true; }
+	template <typename U>
+	bool operator!=(const PoolAllocator<U> &) const { return false; }
+};
+
+}
+}
+}
@@ -0,0 +1,138 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LockFile.h"
+
+#include <QFileInfo>
+#include <QLockFile>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Exception.h"
+#include "FileSystem.h"
+
+namespace Ralph {
+namespace ClientLib {
+
+namespace {
+/// Tries to lock without waiting, throws if it will never succeed (like if the directory does not exist)
+bool tryLock(QLockFile &lock, const QString &path)
+{
+	if (lock.tryLock(0)) {
+		return true;
+	}
+	if (lock.error() != QLockFile::LockFailedError) {
+		throw Exception("Unable to create the lock file %1" % path);
+	}
+	return false;
+}
+
+class LockWaiter
+{
+public:
+	static LockWaiter *instance()
+	{
+		// intentionally leaked, like the Executor
+		static LockWaiter *waiter = new LockWaiter;
+		return waiter;
+	}
+
+	Future<void> wait(const std::shared_ptr<QLockFile> &lock, const QString &path)
+	{
+		Promise<void> promise;
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			m_waiting.push_back(Waiting{lock, path, promise});
+		}
+		m_condition.notify_one();
+		return promise.future();
+	}
+
+private:
+	struct Waiting
+	{
+		std::shared_ptr<QLockFile> lock;
+		QString path;
+		Promise<void> promise;
+	};
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<Waiting> m_waiting;
+
+	LockWaiter()
+	{
+		std::thread([this]() { run(); }).detach();
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> guard(m_mutex);
+		while (true) {
+			m_condition.wait(guard, [this]() { return !m_waiting.empty(); });
+			std::vector<Waiting> waiting;
+			waiting.swap(m_waiting);
+
+			// nobody else touches the locks until we are done with them, so they don't need the mutex
+			guard.unlock();
+			std::vector<Waiting> stillWaiting;
+			for (Waiting &entry : waiting) {
+				if (entry.promise.isCancelRequested()) {
+					entry.promise.reportCanceled();
+					continue;
+				}
+				try {
+					if (tryLock(*entry.lock, entry.path)) {
+						Private::fulfil(entry.promise, []() {});
+					} else {
+						stillWaiting.push_back(entry);
+					}
+				} catch (...) {
+					entry.promise.reportException(std::current_exception());
+				}
+			}
+			if (!stillWaiting.empty()) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			}
+			guard.lock();
+			m_waiting.insert(m_waiting.end(), stillWaiting.begin(), stillWaiting.end());
+		}
+	}
+};
+}
+
+Future<std::shared_ptr<QLockFile>> acquireLock(const QString &path, const QString &waitingStatus, const int staleLockTime)
+{
+	std::shared_ptr<QLockFile> lock = std::make_shared<QLockFile>(path);
+	lock->setStaleLockTime(staleLockTime);
+	return async([lock, path]()
+	{
+		FS::ensureExists(QFileInfo(path).dir());
+		return tryLock(*lock, path);
+	}).then([lock, path, waitingStatus](const bool locked, Notifier notifier)
+	{
+		if (locked) {
+			return makeReadyFuture();
+		}
+		notifier.status(waitingStatus);
+		return LockWaiter::instance()->wait(lock, path);
+	}).then([lock]() { return lock; });
+}
+
+}
+}
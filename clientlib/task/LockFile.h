@@ -0,0 +1,39 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "Task.h"
+
+class QLockFile;
+
+namespace Ralph {
+namespace ClientLib {
+
+/**
+ * Locks path (using QLockFile, creating its directory if needed), which is how ralph processes keep out of each
+ * other's way.
+ *
+ * While another process holds it the lock is polled from a thread of its own rather than from an
+ * Executor thread, and waitingStatus is reported. Locks older than staleLockTime are assumed to be
+ * left behind by a crash, dead owners on this host are noticed right away. The lock is released
+ * once the returned QLockFile is destroyed.
+ */
+Future<std::shared_ptr<QLockFile>> acquireLock(const QString &path, const QString &waitingStatus, const int staleLockTime = 30 * 1000);
+
+}
+}
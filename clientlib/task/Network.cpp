@@ -21,9 +21,13 @@
 #include <QFile>
 #include <QDir>
 #include <QFileInfo>
+#include <QLockFile>
 
 #include <curl/curl.h>
 
+#include "future/SingleFlight.h"
+#include "LockFile.h"
+
 namespace Ralph {
 namespace ClientLib {
 namespace Network {
@@ -36,11 +40,16 @@ struct NetworkCallbackData
 	Notifier notifier;
 };
 
+// concurrent requests for the same thing share a single transfer
+static SingleFlight<void> s_downloads;
+static SingleFlight<QByteArray> s_gets;
+
 static int progressCallback(void *data, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
 {
 	NetworkCallbackData *ncd = static_cast<NetworkCallbackData *>(data);
 	ncd->notifier.progress(std::size_t(dlnow + ulnow), std::size_t(dltotal + ultotal));
-	return CURLE_OK;
+	// anything non-zero aborts the transfer
+	return ncd->notifier.isCanceled() ? 1 : 0;
 }
 static size_t writeCallback(void *contents, size_t size, size_t nmemb, void *data)
 {
@@ -61,6 +70,7 @@ static void commonSetup(CURL *curl, const QUrl &url, const NetworkCallbackData &
 	ec(curl_easy_setopt(curl, CURLOPT_USERAGENT, "ralph"));
 	ec(curl_easy_setopt(curl, CURLOPT_URL, url.toString(QUrl::FullyEncoded).toUtf8().constData()));
 	ec(curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L));
+	ec(curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L));
 	ec(curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, &progressCallback));
 	ec(curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &progressData));
 	ec(curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &writeCallback));
@@ -74,58 +84,72 @@ Future<void> download(const QUrl &url, const QString &destination)
 				QDir(destination).absoluteFilePath(QFileInfo(url.path()).fileName())
 			  : destination;
 
-	return async([url, dest](Notifier notifier)
+	return s_downloads.run(url.toString() + '\n' + dest, [url, dest]()
 	{
-		NetworkCallbackData progressData{notifier};
-
-		char errorbuf[CURL_ERROR_SIZE];
-		errorbuf[0] = '\0';
-
-		// error check function
-		auto ec = [errorbuf](CURLcode code) { NetworkException::throwIfError(code, errorbuf); };
-
-		CURL *curl = curl_easy_init();
-		try {
-			QFile file(dest);
-
-			if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
-				throw NetworkException("Unable to open download destionation: " + file.errorString());
-			}
-
-			commonSetup(curl, url, progressData, &file, errorbuf);
-			ec(curl_easy_perform(curl));
-			curl_easy_cleanup(curl);
-		} catch (...) {
-			curl_easy_cleanup(curl);
-			/*re-*/throw;
-		}
+		// other ralph processes might be downloading to the same place
+		return acquireLock(dest + ".lock", "Waiting for another process downloading to %1..." % dest).then([url, dest](const std::shared_ptr<QLockFile> &lock)
+		{
+			return async(Resource::Network, [url, dest, lock](Notifier notifier)
+			{
+				NetworkCallbackData progressData{notifier};
+
+				char errorbuf[CURL_ERROR_SIZE];
+				errorbuf[0] = '\0';
+
+				// error check function
+				auto ec = [errorbuf](CURLcode code) { NetworkException::throwIfError(code, errorbuf); };
+
+				CURL *curl = curl_easy_init();
+				try {
+					QFile file(dest);
+
+					if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+						throw NetworkException("Unable to open download destionation: " + file.errorString());
+					}
+
+					commonSetup(curl, url, progressData, &file, errorbuf);
+					ec(curl_easy_perform(curl));
+					curl_easy_cleanup(curl);
+					// before the lock, so whoever waited for us sees all of it
+					file.close();
+					lock->unlock();
+				} catch (...) {
+					curl_easy_cleanup(curl);
+					lock->unlock();
+					/*re-*/throw;
+				}
+			});
+		});
 	});
 }
 Future<QByteArray> get(const QUrl &url)
 {
-	return async([url](Notifier notifier)
+	return s_gets.run(url.toString(), [url]()
 	{
-		NetworkCallbackData progressData{notifier};
+		return async(Resource::Network, [url](Notifier notifier)
+		{
+			NetworkCallbackData progressData{notifier};
 
-		char errorbuf[CURL_ERROR_SIZE];
-		errorbuf[0] = '\0';
+			char errorbuf[CURL_ERROR_SIZE];
+			errorbuf[0] = '\0';
 
-		// error check function
-		auto ec = [errorbuf](CURLcode code) { NetworkException::throwIfError(code, errorbuf); };
+			// error check function
+			auto ec = [errorbuf](CURLcode code) { NetworkException::throwIfError(code, errorbuf); };
 
-		CURL *curl = curl_easy_init();
-		try {
-			QBuffer buffer;
+			CURL *curl = curl_easy_init();
+			try {
+				QBuffer buffer;
 
-			commonSetup(curl, url, progressData, &buffer, errorbuf);
-			ec(curl_easy_perform(curl));
-			curl_easy_cleanup(curl);
+				commonSetup(curl, url, progressData, &buffer, errorbuf);
+				ec(curl_easy_perform(curl));
+				curl_easy_cleanup(curl);
 
-			return buffer.data();
-		} catch (...) {
-			curl_easy_cleanup(curl);
-			/*re-*/throw;
-		}
+				return buffer.data();
+			} catch (...) {
+				curl_easy_cleanup(curl);
+				/*re-*/throw;
+			}
+		});
 	});
 }
 
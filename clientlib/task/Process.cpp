@@ -21,6 +21,18 @@
 namespace Ralph {
 namespace ClientLib {
 
+// kills the process if the task gets canceled while waiting
+static void waitForFinished(QProcess *proc, const Notifier &notifier)
+{
+	while (proc->state() != QProcess::NotRunning && !proc->waitForFinished(100)) {
+		if (notifier.isCanceled()) {
+			proc->kill();
+			proc->waitForFinished(-1);
+			notifier.checkCanceled();
+		}
+	}
+}
+
 Process::Process(const QString &executable)
 	: m_executable(executable)
 {
@@ -28,7 +40,7 @@ Process::Process(const QString &executable)
 
 Future<void> Process::run() const
 {
-	return async([this](Notifier notifier)
+	return async(Resource::Process, [this](Notifier notifier)
 	{
 		std::unique_ptr<QProcess> proc = prime();
 		QProcess *procPtr = proc.get();
@@ -45,7 +57,7 @@ Future<void> Process::run() const
 		});
 		procPtr->start(QProcess::ReadOnly);
 		procPtr->waitForStarted();
-		procPtr->waitForFinished(-1);
+		waitForFinished(procPtr, notifier);
 
 		if (procPtr->error() != QProcess::UnknownError) {
 			if (procPtr->exitStatus() == QProcess::CrashExit) {
@@ -58,7 +70,7 @@ Future<void> Process::run() const
 }
 Future<QByteArray> Process::runCaptureOutput() const
 {
-	return async([this](Notifier notifier)
+	return async(Resource::Process, [this](Notifier notifier)
 	{
 		std::unique_ptr<QProcess> proc = prime();
 		QProcess *procPtr = proc.get();
@@ -71,7 +83,7 @@ Future<QByteArray> Process::runCaptureOutput() const
 		});
 		procPtr->start(QProcess::ReadOnly);
 		procPtr->waitForStarted();
-		procPtr->waitForFinished(-1);
+		waitForFinished(procPtr, notifier);
 
 		if (procPtr->error() != QProcess::UnknownError) {
 			if (procPtr->exitStatus() == QProcess::CrashExit) {
@@ -0,0 +1,123 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Resource.h"
+
+#include <deque>
+#include <mutex>
+
+namespace Ralph {
+namespace ClientLib {
+
+namespace {
+struct Slots
+{
+	explicit Slots(const std::size_t max) : limit(max) {}
+
+	std::mutex mutex;
+	std::size_t limit;
+	std::size_t running = 0;
+	std::deque<Executor::Job> pending;
+};
+
+Slots &slotsFor(const Resource resource)
+{
+	// 8 connections keep the pipe full without being rude to servers, more than 2 concurrent
+	// extractions just make the disk seek, compilers get one core each
+	static Slots network(8);
+	static Slots disk(2);
+	static Slots process(Executor::defaultThreadCount());
+	static Slots cpu(0);
+	switch (resource) {
+	case Resource::Network: return network;
+	case Resource::Disk: return disk;
+	case Resource::Process: return process;
+	case Resource::Cpu: return cpu;
+	}
+	return cpu;
+}
+
+void release(const Resource resource);
+Executor::Job wrap(const Resource resource, Executor::Job &&job)
+{
+	return [resource, job]()
+	{
+		job();
+		release(resource);
+	};
+}
+void release(const Resource resource)
+{
+	Slots &slots = slotsFor(resource);
+	Executor::Job next;
+	{
+		std::lock_guard<std::mutex> lock(slots.mutex);
+		if (slots.pending.empty()) {
+			--slots.running;
+			return;
+		}
+		// the slot is handed on directly
+		next = std::move(slots.pending.front());
+		slots.pending.pop_front();
+	}
+	Executor::instance()->submit(wrap(resource, std::move(next)));
+}
+}
+
+std::size_t ResourceLimits::limit(const Resource resource)
+{
+	Slots &slots = slotsFor(resource);
+	std::lock_guard<std::mutex> lock(slots.mutex);
+	return slots.limit;
+}
+void ResourceLimits::setLimit(const Resource resource, const std::size_t limit)
+{
+	Slots &slots = slotsFor(resource);
+	std::deque<Executor::Job> startable;
+	{
+		std::lock_guard<std::mutex> lock(slots.mutex);
+		slots.limit = limit;
+		// a higher limit applies to the tasks that are already waiting as well
+		while (!slots.pending.empty() && (slots.limit == 0 || slots.running < slots.limit)) {
+			++slots.running;
+			startable.push_back(std::move(slots.pending.front()));
+			slots.pending.pop_front();
+		}
+	}
+	for (Executor::Job &job : startable) {
+		Executor::instance()->submit(wrap(resource, std::move(job)));
+	}
+}
+
+void ResourceLimits::submit(const Resource resource, Executor::Job &&job)
+{
+	if (resource == Resource::Cpu) {
+		Executor::instance()->submit(std::move(job));
+		return;
+	}
+	Slots &slots = slotsFor(resource);
+	{
+		std::lock_guard<std::mutex> lock(slots.mutex);
+		if (slots.limit > 0 && slots.running >= slots.limit) {
+			slots.pending.push_back(std::move(job));
+			return;
+		}
+		++slots.running;
+	}
+	Executor::instance()->submit(wrap(resource, std::move(job)));
+}
+
+}
+}
@@ -0,0 +1,54 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "Executor.h"
+
+namespace Ralph {
+namespace ClientLib {
+
+/// What a task mostly spends its time on, see ResourceLimits
+enum class Resource
+{
+	Cpu, ///< The default, only limited by the number of Executor threads
+	Network, ///< Downloads, clones and fetches
+	Disk, ///< Extraction, checkouts and other bulk file system operations
+	Process ///< Waiting for child processes like compilers, which use cores of their own
+};
+
+/**
+ * Limits how many tasks of each resource class run at the same time.
+ *
+ * Tasks over the limit are kept back until one of the running ones finishes, without occupying an
+ * Executor thread in the meantime. A task that awaits a task of its own class lends it its slot (see
+ * Notifier::await), since it could otherwise wait for a slot it is holding itself.
+ */
+class ResourceLimits
+{
+public:
+	/// 0 means unlimited
+	static std::size_t limit(const Resource resource);
+	/// Tasks that are already running are not affected by a lower limit, waiting ones are started if it is higher
+	static void setLimit(const Resource resource, const std::size_t limit);
+
+	/// Submits job to the Executor once there is a free slot for resource
+	static void submit(const Resource resource, Executor::Job &&job);
+};
+
+}
+}
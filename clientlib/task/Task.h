@@ -22,15 +22,34 @@
 #include "Functional.h"
 #include "Exception.h"
 #include "future/Future.h"
+#include "task/FramePool.h"
+#include "task/Resource.h"
 
 namespace Ralph {
 namespace ClientLib {
 template <typename> class Task;
+
 namespace Private {
-template <typename T>
-inline void runAndReportResult(Task<T> *task);
-template <>
-inline void runAndReportResult<void>(Task<void> *task);
+/// Runs body and reports its result to promise, unless the task was canceled before it got to run
+template <typename T, typename Func>
+void runTask(Promise<T> &promise, Func &&body)
+{
+	if (promise.isCancelRequested()) {
+		promise.reportCanceled();
+		return;
+	}
+	try {
+		promise.reportStarted();
+		fulfilWith(promise, std::forward<Func>(body));
+		promise.reportFinished();
+	} catch (...) {
+		if (promise.isCancelRequested()) {
+			promise.reportCanceled();
+		} else {
+			promise.reportException(std::current_exception());
+		}
+	}
+}
 }
 
 template <typename T>
@@ -43,23 +62,14 @@ public:
 
 	Future<T> start()
 	{
-		m_promise.prime(std::async(m_policy, [this]()
-		{
-			try {
-				m_promise.reportStarted();
-				Private::runAndReportResult(this);
-				m_promise.reportFinished();
-			} catch (...) {
-				m_promise.reportException(std::current_exception());
-			}
-		}));
+		// scheduled on the Executor once the future is started
+		m_promise.prime(m_policy, [this]() { Private::runTask(m_promise, [this]() { return run(); }); });
 		return future();
 	}
 
 	Future<T> future() const { return m_promise.future(); }
 
 protected:
-	friend void Private::runAndReportResult<T>(Task<T> *);
 	virtual T run() = 0;
 
 	void reportStatus(const QString &status) { m_promise.reportStatus(status); }
@@ -71,115 +81,73 @@ private:
 	Promise<T> m_promise;
 };
 
-class Notifier
-{
-	mutable Private::BasePromise m_promise;
-public:
-	template <typename T>
-	explicit Notifier(Task<T> *task)
-		: m_promise(task->m_promise) {}
-
-	void status(const QString &status) const { m_promise.reportStatus(status); }
-	void progress(const std::size_t current, const std::size_t total) const { m_promise.reportProgress(current, total); }
-
-	template <typename T>
-	inline T await(const Future<T> &future) const
-	{
-		return m_promise.await(future);
-	}
-};
-template <>
-inline void Notifier::await<void>(const Future<void> &future) const
-{
-	m_promise.await(future);
-}
-
 namespace Private {
-template <typename T>
-inline void runAndReportResult(Task<T> *task)
-{
-	task->m_promise.reportResult(task->run());
-}
-template <>
-inline void runAndReportResult<void>(Task<void> *task)
-{
-	task->run();
-}
-
 using Ralph::Common::Functional::FunctionTraits;
 
-template <typename Func>
-std::enable_if_t<FunctionTraits<Func>::arity == 0, void>
-callWithoutReturn(Func &&func, Notifier &&)
-{
-	func();
-}
-template <typename Func>
-std::enable_if_t<FunctionTraits<Func>::arity == 1, void>
-callWithoutReturn(Func &&func, Notifier &&notifier)
-{
-	func(std::forward<Notifier>(notifier));
-}
 template <typename Func, typename T>
 std::enable_if_t<FunctionTraits<Func>::arity == 0, T>
-callWithReturn(Func &&func, Notifier &&)
+callWithReturn(Func &func, Notifier &&)
 {
 	return func();
 }
 template <typename Func, typename T>
 std::enable_if_t<FunctionTraits<Func>::arity == 1, T>
-callWithReturn(Func &&func, Notifier &&notifier)
+callWithReturn(Func &func, Notifier &&notifier)
 {
 	return func(std::forward<Notifier>(notifier));
 }
 
+/**
+ * The future state and the function of an async() call in one object.
+ *
+ * Together with std::allocate_shared and the FramePool this makes starting a task a single
+ * (usually recycled) allocation. The frame is kept alive by the futures and by the Executor
+ * while it is queued, so unlike a Task it does not need to keep itself alive.
+ */
 template <typename T, typename Func>
-class LambdaTask : public Task<T>
+class TaskFrame : public FutureData<T>
 {
 	Func m_func;
 public:
-	explicit LambdaTask(std::launch policy, Func &&func) : Task<T>(policy), m_func(std::forward<Func>(func)) {}
-	static std::shared_ptr<LambdaTask<T, Func>> make(std::launch policy, Func &&func)
+	template <typename F>
+	explicit TaskFrame(const std::launch launchPolicy, const Resource resourceClass, F &&func)
+		: m_func(std::forward<F>(func))
 	{
-		std::shared_ptr<LambdaTask<T, Func>> ptr = std::make_shared<LambdaTask<T, Func>>(policy, std::forward<Func>(func));
-		ptr->keepAlive(ptr);
-		return ptr;
+		this->policy = launchPolicy;
+		this->resource = resourceClass;
+		this->hasJob = true;
 	}
 
-	T run()
+	void execute() override
 	{
-		return callWithReturn<Func, T>(std::move(m_func), Notifier(this));
-	}
-};
-template <typename Func>
-class LambdaTask<void, Func> : public Task<void>
-{
-	Func m_func;
-public:
-	explicit LambdaTask(std::launch policy, Func &&func) : Task<void>(policy), m_func(std::forward<Func>(func)) {}
-	static std::shared_ptr<LambdaTask<void, Func>> make(std::launch policy, Func &&func)
-	{
-		std::shared_ptr<LambdaTask<void, Func>> ptr = std::make_shared<LambdaTask<void, Func>>(policy, std::forward<Func>(func));
-		ptr->keepAlive(ptr);
-		return ptr;
-	}
-
-	void run()
-	{
-		callWithoutReturn<Func>(std::move(m_func), Notifier(this));
+		Promise<T> promise(std::static_pointer_cast<FutureData<T>>(this->shared_from_this()));
+		runTask(promise, [this, &promise]() { return callWithReturn<Func, T>(m_func, Notifier(promise)); });
 	}
 };
 }
 
+/// Runs func on the Executor once started, or on the first thread waiting for it if policy is deferred.
+/// Tasks of the given resource class are subject to its ResourceLimits.
 template <typename Func, typename Type = typename Common::Functional::FunctionTraits<Func>::ReturnType>
-Future<Type> async(Func &&func)
+Future<Type> async(std::launch policy, Resource resource, Func &&func)
 {
-	return Private::LambdaTask<Type, Func>::make(std::launch::deferred, std::forward<Func>(func))->start();
+	using Frame = Private::TaskFrame<Type, std::decay_t<Func>>;
+	return Future<Type>(std::allocate_shared<Frame>(Private::PoolAllocator<Frame>(), policy, resource, std::forward<Func>(func)));
 }
 template <typename Func, typename Type = typename Common::Functional::FunctionTraits<Func>::ReturnType>
 Future<Type> async(std::launch policy, Func &&func)
 {
-	return Private::LambdaTask<Type, Func>::make(policy, std::forward<Func>(func))->start();
+	return async(policy, Resource::Cpu, std::forward<Func>(func));
+}
+template <typename Func, typename Type = typename Common::Functional::FunctionTraits<Func>::ReturnType>
+Future<Type> async(Resource resource, Func &&func)
+{
+	return async(std::launch::async, resource, std::forward<Func>(func));
+}
+template <typename Func, typename Type = typename Common::Functional::FunctionTraits<Func>::ReturnType>
+Future<Type> async(Func &&func)
+{
+	return async(std::launch::async, std::forward<Func>(func));
 }
 
 }
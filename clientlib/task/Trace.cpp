@@ -0,0 +1,126 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Trace.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <chrono>
+#include <mutex>
+
+#include "Json.h"
+
+namespace Ralph {
+namespace ClientLib {
+
+std::atomic<bool> Trace::s_enabled{false};
+
+namespace {
+std::mutex s_mutex;
+QString s_filename;
+QJsonArray s_events;
+std::chrono::steady_clock::time_point s_start;
+std::atomic<std::uint64_t> s_nextId{1};
+std::atomic<int> s_nextThreadId{1};
+
+int currentThreadId()
+{
+	thread_local int id = s_nextThreadId++;
+	return id;
+}
+
+void add(QJsonObject &&event)
+{
+	event.insert("pid", int(QCoreApplication::applicationPid()));
+	event.insert("tid", currentThreadId());
+	std::lock_guard<std::mutex> lock(s_mutex);
+	s_events.append(event);
+}
+}
+
+void Trace::enable(const QString &filename)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_filename = filename;
+		s_start = std::chrono::steady_clock::now();
+	}
+	s_enabled = true;
+}
+void Trace::write()
+{
+	if (!isEnabled()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(s_mutex);
+	QJsonObject obj;
+	obj.insert("traceEvents", s_events);
+	obj.insert("displayTimeUnit", QStringLiteral("ms"));
+	Json::write(obj, s_filename);
+}
+
+std::int64_t Trace::now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_start).count();
+}
+std::uint64_t Trace::nextId()
+{
+	return s_nextId++;
+}
+
+void Trace::complete(const QString &name, const std::int64_t start, const std::int64_t duration, const QJsonObject &args)
+{
+	QJsonObject event;
+	event.insert("name", name);
+	event.insert("ph", QStringLiteral("X"));
+	event.insert("ts", qint64(start));
+	event.insert("dur", qint64(duration));
+	event.insert("args", args);
+	add(std::move(event));
+}
+void Trace::instant(const QString &name, const QJsonObject &args)
+{
+	QJsonObject event;
+	event.insert("name", name);
+	event.insert("ph", QStringLiteral("i"));
+	event.insert("s", QStringLiteral("t"));
+	event.insert("ts", qint64(now()));
+	event.insert("args", args);
+	add(std::move(event));
+}
+void Trace::flowStart(const std::uint64_t id)
+{
+	QJsonObject event;
+	event.insert("name", QStringLiteral("await"));
+	event.insert("cat", QStringLiteral("task"));
+	event.insert("ph", QStringLiteral("s"));
+	event.insert("id", qint64(id));
+	event.insert("ts", qint64(now()));
+	add(std::move(event));
+}
+void Trace::flowEnd(const std::uint64_t id, const std::int64_t timestamp)
+{
+	QJsonObject event;
+	event.insert("name", QStringLiteral("await"));
+	event.insert("cat", QStringLiteral("task"));
+	event.insert("ph", QStringLiteral("f"));
+	// binds to the slice enclosing the timestamp, which is the one of the task that was awaited
+	event.insert("bp", QStringLiteral("e"));
+	event.insert("id", qint64(id));
+	event.insert("ts", qint64(timestamp));
+	add(std::move(event));
+}
+}
+}
@@ -0,0 +1,58 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+
+namespace Ralph {
+namespace ClientLib {
+
+/**
+ * Collects Chrome trace events (chrome://tracing or ui.perfetto.dev) for tasks.
+ *
+ * Every instrumentation point first checks isEnabled(), which is a single relaxed atomic load,
+ * so tracing costs nothing unless enable() has been called.
+ */
+class Trace
+{
+public:
+	static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+	/// Starts collecting events, write() puts them into filename
+	static void enable(const QString &filename);
+	/// Writes all events collected so far, should be called once everything has finished
+	static void write();
+
+	/// Microseconds since tracing was enabled
+	static std::int64_t now();
+	static std::uint64_t nextId();
+
+	/// A slice from start to start + duration on the current thread
+	static void complete(const QString &name, const std::int64_t start, const std::int64_t duration, const QJsonObject &args = QJsonObject());
+	static void instant(const QString &name, const QJsonObject &args = QJsonObject());
+	/// Arrows from where a task was awaited (flowStart) to where it ran (flowEnd)
+	static void flowStart(const std::uint64_t id);
+	static void flowEnd(const std::uint64_t id, const std::int64_t timestamp);
+
+private:
+	static std::atomic<bool> s_enabled;
+};
+
+}
+}
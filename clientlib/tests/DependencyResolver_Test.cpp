@@ -0,0 +1,196 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFile>
+#include <memory>
+
+#include "package/DependencyResolver.h"
+#include "package/PackageDatabase.h"
+#include "package/PackageSource.h"
+#include "package/Package.h"
+
+using namespace Ralph::ClientLib;
+
+static QVector<PackageDependency> toDependencies(const QVector<QString> &dependencies)
+{
+	QVector<PackageDependency> out;
+	for (const QString &dependency : dependencies) {
+		PackageDependency dep;
+		dep.setPackage(dependency.section(' ', 0, 0));
+		dep.setVersion(VersionRequirement::fromString(dependency.section(' ', 1)));
+		out.append(dep);
+	}
+	return out;
+}
+
+// a git repo source without the git
+class LocalPackageSource : public GitRepoPackageSource
+{
+public:
+	Future<QString> revision() const override { return makeReadyFuture(QString()); }
+};
+
+class DependencyResolver_Test : public QObject
+{
+	Q_OBJECT
+public:
+	virtual ~DependencyResolver_Test();
+
+private:
+	std::unique_ptr<QTemporaryDir> m_dir;
+	std::unique_ptr<PackageDatabase> m_db;
+	std::unique_ptr<LocalPackageSource> m_source;
+	int m_manifests = 0;
+
+	void add(const QString &name, const QString &version, const QVector<QString> &dependencies = {})
+	{
+		QJsonArray deps;
+		for (const QString &dependency : dependencies) {
+			deps.append(QJsonObject({{"name", dependency.section(' ', 0, 0)}, {"version", dependency.section(' ', 1)}}));
+		}
+		QFile f(m_source->basePath().absoluteFilePath(QString("pkg%1.json").arg(m_manifests++)));
+		QVERIFY(f.open(QFile::WriteOnly | QFile::Truncate));
+		f.write(QJsonDocument(QJsonObject({{"name", name}, {"version", version}, {"dependencies", deps}})).toJson());
+	}
+
+	DependencyResolver::Resolution resolve(const QVector<QString> &dependencies, const QHash<QString, Version> &preferred = {})
+	{
+		m_source->setLastUpdated();
+		m_db->build().result();
+		Package root;
+		root.setName("root");
+		root.setVersion(Version::fromString("1.0.0"));
+		root.setDependencies(toDependencies(dependencies));
+		DependencyResolver resolver(m_db.get());
+		resolver.setPreferred(preferred);
+		return resolver.resolve(&root);
+	}
+	static QVector<QString> describe(const QVector<const Package *> &packages)
+	{
+		QVector<QString> out;
+		for (const Package *pkg : packages) {
+			out.append(pkg->name() + ' ' + pkg->version().toString());
+		}
+		return out;
+	}
+
+private slots:
+	void init()
+	{
+		m_dir = std::make_unique<QTemporaryDir>();
+		m_db.reset(PackageDatabase::get(m_dir->path()).result());
+		m_source = std::make_unique<LocalPackageSource>();
+		m_source->setName("main");
+		m_db->registerPackageSource(m_source.get()).result();
+		QVERIFY(m_source->basePath().mkpath(m_source->basePath().absolutePath()));
+		m_manifests = 0;
+	}
+	void cleanup()
+	{
+		m_db.reset();
+		m_source.reset();
+		m_dir.reset();
+	}
+
+	void chain()
+	{
+		add("app", "1.0.0", {"lib >=1.0.0"});
+		add("app", "2.0.0", {"lib >=2.0.0"});
+		add("lib", "1.0.0");
+		add("lib", "2.0.0");
+		add("lib", "2.1.0", {"util ==1.0.0"});
+		add("util", "1.0.0");
+		add("util", "2.0.0");
+
+		const DependencyResolver::Resolution resolution = resolve({"app >=1.0.0"});
+		// newest versions, dependencies first
+		QCOMPARE(describe(resolution.packages), QVector<QString>({"util 1.0.0", "lib 2.1.0", "app 2.0.0"}));
+		QCOMPARE(describe(resolution.dependencies.value(resolution.packages.at(2))), QVector<QString>({"lib 2.1.0"}));
+		QCOMPARE(describe(resolution.dependencies.value(resolution.packages.at(1))), QVector<QString>({"util 1.0.0"}));
+		QVERIFY(resolution.dependencies.value(resolution.packages.at(0)).isEmpty());
+	}
+	void diamondConflict()
+	{
+		// a is decided first (fewer versions), its newest version pins c to 2.0.0, which no version of b accepts,
+		// so the resolver has to jump back past the decision for c to the one for a
+		add("a", "1.0.0", {"c ==1.0.0"});
+		add("a", "2.0.0", {"c ==2.0.0"});
+		add("b", "1.0.0", {"c ==1.0.0"});
+		add("b", "1.1.0", {"c ==1.0.0"});
+		add("b", "1.2.0", {"c ==1.0.0"});
+		add("c", "1.0.0");
+		add("c", "2.0.0");
+
+		const DependencyResolver::Resolution resolution = resolve({"a >=1.0.0", "b >=1.0.0"});
+		QCOMPARE(describe(resolution.packages), QVector<QString>({"c 1.0.0", "a 1.0.0", "b 1.2.0"}));
+	}
+	void noSolution()
+	{
+		add("foo", "1.0.0", {"baz ==1.0.0"});
+		add("bar", "1.0.0", {"baz ==2.0.0"});
+		add("baz", "1.0.0");
+		add("baz", "2.0.0");
+
+		try {
+			resolve({"foo >=1.0.0", "bar >=1.0.0"});
+			QFAIL("Expected an exception");
+		} catch (DependencyResolverException &e) {
+			const QString explanation = e.cause();
+			QVERIFY2(explanation.startsWith("Unable to resolve the dependencies of root:\n"), qPrintable(explanation));
+			// every step that leads to the conflict is in there, ending with the conclusion
+			QVERIFY2(explanation.contains("foo depends on baz ==1.0.0"), qPrintable(explanation));
+			QVERIFY2(explanation.contains("bar depends on baz ==2.0.0"), qPrintable(explanation));
+			QVERIFY2(explanation.contains("root depends on"), qPrintable(explanation));
+			QVERIFY2(explanation.endsWith("version solving failed."), qPrintable(explanation));
+		}
+	}
+	void missingPackage()
+	{
+		add("foo", "1.0.0", {"missing >=1.0.0"});
+
+		try {
+			resolve({"foo >=1.0.0"});
+			QFAIL("Expected an exception");
+		} catch (DependencyResolverException &e) {
+			QVERIFY2(e.cause().contains("foo depends on missing >=1.0.0 which matches no known version"), qPrintable(e.cause()));
+		}
+	}
+	void preferredVersions()
+	{
+		add("app", "1.0.0", {"lib >=1.0.0"});
+		add("lib", "1.0.0");
+		add("lib", "1.1.0");
+		add("lib", "2.0.0");
+
+		// like a lock file
+		QCOMPARE(describe(resolve({"app >=1.0.0"}, {{"lib", Version::fromString("1.1.0")}}).packages), QVector<QString>({"lib 1.1.0", "app 1.0.0"}));
+		// unless it is no longer allowed, or no longer exists
+		QCOMPARE(describe(resolve({"app >=1.0.0", "lib >=2.0.0"}, {{"lib", Version::fromString("1.1.0")}}).packages),
+				 QVector<QString>({"lib 2.0.0", "app 1.0.0"}));
+		QCOMPARE(describe(resolve({"app >=1.0.0"}, {{"lib", Version::fromString("1.5.0")}}).packages), QVector<QString>({"lib 2.0.0", "app 1.0.0"}));
+		// and everything else still gets the newest version
+		QCOMPARE(describe(resolve({"app >=1.0.0"}).packages), QVector<QString>({"lib 2.0.0", "app 1.0.0"}));
+	}
+};
+DependencyResolver_Test::~DependencyResolver_Test() {}
+
+QTEST_GUILESS_MAIN(DependencyResolver_Test)
+
+#include "DependencyResolver_Test.moc"
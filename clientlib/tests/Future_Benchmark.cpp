@@ -0,0 +1,165 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QTest>
+
+#include "future/Future.h"
+#include "future/FutureWatcher.h"
+#include "future/FutureCombinators.h"
+#include "task/Task.h"
+
+using namespace Ralph::ClientLib;
+
+Q_DECLARE_METATYPE(std::launch)
+
+/**
+ * Benchmarks for the future/task layer, run with -tickcounter or -perf for more stable numbers.
+ * Everything is data driven so that the rows show up separately in the results and regressions
+ * in one of them are not hidden by the others.
+ */
+class Future_Benchmark : public QObject
+{
+	Q_OBJECT
+public:
+	virtual ~Future_Benchmark();
+
+private slots:
+	void spawn_data()
+	{
+		QTest::addColumn<std::launch>("policy");
+		QTest::newRow("async") << std::launch::async;
+		QTest::newRow("deferred") << std::launch::deferred;
+	}
+	void spawn()
+	{
+		QFETCH(std::launch, policy);
+		QBENCHMARK {
+			QCOMPARE(async(policy, []() { return 42; }).result(), 42);
+		}
+	}
+
+	void awaitChain_data()
+	{
+		QTest::addColumn<int>("depth");
+		for (int depth = 1; depth <= 64; depth *= 2) {
+			QTest::newRow(qPrintable(QString::number(depth))) << depth;
+		}
+	}
+	void awaitChain()
+	{
+		QFETCH(int, depth);
+		std::function<Future<int>(int)> nested = [&nested](const int remaining)
+		{
+			return async([&nested, remaining](Notifier notifier)
+			{
+				return remaining == 0 ? 0 : notifier.await(nested(remaining - 1)) + 1;
+			});
+		};
+		QBENCHMARK {
+			QCOMPARE(nested(depth).result(), depth);
+		}
+	}
+	void continuationChain_data()
+	{
+		awaitChain_data();
+	}
+	void continuationChain()
+	{
+		QFETCH(int, depth);
+		QBENCHMARK {
+			Future<int> future = makeReadyFuture(0);
+			for (int i = 0; i < depth; ++i) {
+				future = future.then([](const int value) { return value + 1; });
+			}
+			QCOMPARE(future.result(), depth);
+		}
+	}
+
+	void fanOut_data()
+	{
+		spawn_data();
+	}
+	void fanOut()
+	{
+		QFETCH(std::launch, policy);
+		QBENCHMARK {
+			QVector<Future<int>> futures;
+			futures.reserve(1000);
+			for (int i = 0; i < 1000; ++i) {
+				futures.append(async(policy, [i]() { return i; }));
+			}
+			QCOMPARE(whenAll(futures).result().size(), 1000);
+		}
+	}
+
+	void watcherFanOut_data()
+	{
+		QTest::addColumn<int>("watchers");
+		QTest::newRow("1") << 1;
+		QTest::newRow("10") << 10;
+		QTest::newRow("100") << 100;
+	}
+	void watcherFanOut()
+	{
+		QFETCH(int, watchers);
+		QBENCHMARK {
+			Future<void> future = async([](Notifier notifier)
+			{
+				for (int i = 0; i < 10; ++i) {
+					notifier.status("working");
+					notifier.progress(std::size_t(i), 10);
+				}
+			});
+			std::atomic<int> finished{0};
+			std::vector<std::unique_ptr<FutureWatcher<void>>> all;
+			for (int i = 0; i < watchers; ++i) {
+				all.push_back(std::make_unique<FutureWatcher<void>>(future));
+				connect(all.back().get(), &FutureWatcher<void>::finished, [&finished]() { ++finished; });
+			}
+			future.result();
+			QCOMPARE(finished.load(), watchers);
+		}
+	}
+
+	void progressThroughput_data()
+	{
+		QTest::addColumn<bool>("watched");
+		QTest::newRow("unwatched") << false;
+		QTest::newRow("watched") << true;
+	}
+	void progressThroughput()
+	{
+		QFETCH(bool, watched);
+		QBENCHMARK {
+			Future<void> future = async([](Notifier notifier)
+			{
+				for (std::size_t i = 1; i <= 100000; ++i) {
+					notifier.progress(i, 100000);
+				}
+			});
+			std::unique_ptr<FutureWatcher<void>> watcher;
+			if (watched) {
+				watcher = std::make_unique<FutureWatcher<void>>(future);
+			}
+			future.result();
+		}
+	}
+};
+
+Future_Benchmark::~Future_Benchmark() {}
+
+QTEST_GUILESS_MAIN(Future_Benchmark)
+
+#include "Future_Benchmark.moc"
@@ -15,12 +15,23 @@
 
 #include <QTest>
 #include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QFile>
+#include <QLockFile>
 
 #include "future/Future.h"
 #include "future/FutureWatcher.h"
 #include "future/Promise.h"
 #include "future/FutureOperators.h"
+#include "future/FutureCombinators.h"
+#include "future/SingleFlight.h"
 #include "task/Task.h"
+#include "task/Executor.h"
+#include "task/Resource.h"
+#include "task/LockFile.h"
+#include "task/Trace.h"
 
 using namespace Ralph::ClientLib;
 using namespace std::literals;
@@ -81,16 +92,16 @@ private slots:
 		QSignalSpy status(&watcher, SIGNAL(status(QString)));
 
 		future.start();
-		std::this_thread::sleep_for(1ms);
+		// progress and status are delivered by the sampler thread
+		QTRY_COMPARE(progress.size(), 1);
+		QCOMPARE(progress.first(), QList<QVariant>() << 1 << 100);
+		QCOMPARE(status.size(), 1);
+		QCOMPARE(status.first(), QList<QVariant>() << "asdf");
 		QCOMPARE(started.size(), 1);
 		QVERIFY(started.first().isEmpty());
 		QVERIFY(finished.isEmpty());
 		QVERIFY(canceled.isEmpty());
 		QVERIFY(exception.isEmpty());
-		QCOMPARE(progress.size(), 1);
-		QCOMPARE(progress.first(), QList<QVariant>() << 1 << 100);
-		QCOMPARE(status.size(), 1);
-		QCOMPARE(status.first(), QList<QVariant>() << "asdf");
 
 		mutex.unlock();
 		future.result();
@@ -108,6 +119,158 @@ private slots:
 		QCOMPARE(status.at(0), QList<QVariant>() << "asdf");
 		QCOMPARE(status.at(1), QList<QVariant>() << "fdsa");
 	}
+	void progressIsCoalesced()
+	{
+		Future<void> future = async([](Notifier notifier)
+		{
+			for (std::size_t i = 1; i <= 100000; ++i) {
+				notifier.progress(i, 100000);
+			}
+		});
+		FutureWatcher<void> watcher(future);
+		QSignalSpy progress(&watcher, SIGNAL(progress(std::size_t, std::size_t)));
+		future.result();
+
+		// far fewer signals than reports, but the final value always arrives
+		QVERIFY(progress.size() >= 1);
+		QVERIFY(progress.size() < 1000);
+		QCOMPARE(progress.last(), QList<QVariant>() << 100000 << 100000);
+	}
+	void watcherCanBeDeletedFromItsSlot()
+	{
+		// deferred, so that everything is reported from this thread
+		Future<void> future = async(std::launch::deferred, [](Notifier notifier) { notifier.status("asdf"); });
+		FutureWatcher<void> *watcher = new FutureWatcher<void>(future);
+		FutureWatcher<void> *other = new FutureWatcher<void>(future);
+		QSignalSpy finished(other, SIGNAL(finished()));
+		FutureWatcher<void>::connect(watcher, &FutureWatcher<void>::started, [&watcher]()
+		{
+			delete watcher;
+			watcher = nullptr;
+		});
+		future.result();
+		QVERIFY(!watcher);
+		QCOMPARE(finished.size(), 1);
+		delete other;
+	}
+	void nestedAwaitsDoNotExhaustThreads()
+	{
+		// every level blocks in await, which only works if waiting threads help running the inner tasks
+		std::function<Future<int>(int)> nested = [&nested](const int depth)
+		{
+			return async([&nested, depth](Notifier notifier)
+			{
+				return depth == 0 ? 0 : notifier.await(nested(depth - 1)) + 1;
+			});
+		};
+		QCOMPARE(nested(64).result(), 64);
+	}
+	void startedFuturesRunInParallel()
+	{
+		std::atomic<int> running{0};
+		std::atomic<int> maxRunning{0};
+		auto job = [&running, &maxRunning]()
+		{
+			const int now = ++running;
+			int expected = maxRunning;
+			while (now > expected && !maxRunning.compare_exchange_weak(expected, now)) {}
+			std::this_thread::sleep_for(20ms);
+			--running;
+		};
+		Future<void> a = async(job);
+		Future<void> b = async(job);
+		a.start();
+		b.start();
+		a.result();
+		b.result();
+		if (Executor::instance()->threadCount() > 1) {
+			QCOMPARE(maxRunning.load(), 2);
+		}
+	}
+	void continuations()
+	{
+		QCOMPARE(async([]() { return 21; }).then([](const int value) { return value * 2; }).result(), 42);
+		QCOMPARE(async([]() {}).then([]() { return QString("done"); }).result(), QString("done"));
+
+		Future<int> failing = async([]() -> int { throw Exception("failed"); }).then([](const int value) { return value; });
+		QVERIFY_EXCEPTION_THROWN(failing.result(), Exception);
+	}
+	void continuationsCanReturnFutures()
+	{
+		Future<int> chained = async([]() { return 20; })
+				.then([](const int value) { return async([value]() { return value + 1; }); })
+				.then([](const int value, Notifier notifier)
+		{
+			notifier.status("Doubling...");
+			return value * 2;
+		});
+		QCOMPARE(chained.result(), 42);
+
+		Future<void> failing = makeReadyFuture().then([]() { return async([]() { throw Exception("failed"); }); });
+		QVERIFY_EXCEPTION_THROWN(failing.result(), Exception);
+		QCOMPARE(makeReadyFuture(42).result(), 42);
+	}
+	void whenAllKeepsOrder()
+	{
+		QVector<Future<int>> futures;
+		for (int i = 0; i < 100; ++i) {
+			futures.append(async([i]() { return i; }));
+		}
+		const QVector<int> results = whenAll(futures).result();
+		QCOMPARE(results.size(), 100);
+		for (int i = 0; i < 100; ++i) {
+			QCOMPARE(results.at(i), i);
+		}
+
+		QCOMPARE(whenAll(QVector<Future<int>>()).result(), QVector<int>());
+	}
+	void whenAnyReturnsFirst()
+	{
+		std::mutex mutex;
+		mutex.lock();
+		std::atomic<bool> running{false};
+		Future<void> blocked = async([&mutex, &running]() { running = true; mutex.lock(); mutex.unlock(); });
+		blocked.start();
+		// make sure a worker picked it up, and not us while waiting below
+		while (!running) {
+			std::this_thread::yield();
+		}
+		Future<void> quick = async([]() {});
+		QCOMPARE(whenAny(QVector<Future<void>>{blocked, quick}).result(), 1);
+		mutex.unlock();
+		blocked.result();
+	}
+	void cancelation()
+	{
+		std::atomic<bool> running{false};
+		auto spin = [&running](Notifier notifier)
+		{
+			running = true;
+			while (true) {
+				notifier.checkCanceled();
+				std::this_thread::yield();
+			}
+		};
+
+		Future<void> direct = async(spin);
+		direct.start();
+		while (!running) {
+			std::this_thread::yield();
+		}
+		direct.cancel();
+		QVERIFY_EXCEPTION_THROWN(direct.result(), CanceledException);
+		QVERIFY(direct.hasFailed());
+
+		// canceling the outer task also cancels what it awaits
+		running = false;
+		Future<void> outer = async([spin](Notifier notifier) { notifier.await(async(spin)); });
+		outer.start();
+		while (!running) {
+			std::this_thread::yield();
+		}
+		outer.cancel();
+		QVERIFY_EXCEPTION_THROWN(outer.result(), CanceledException);
+	}
 	void futureOperators()
 	{
 		QCOMPARE((async([]() { return 42; }) + async([]() { return 2; })).result(), 44);
@@ -119,6 +282,183 @@ private slots:
 		QCOMPARE((async([]() { return true; }) && async([]() { return false; })).result(), false);
 		QCOMPARE((async([]() { return true; }) || async([]() { return false; })).result(), true);
 	}
+	void resourceLimits()
+	{
+		// the other tests should not be limited by this one
+		struct RestoreLimit
+		{
+			const std::size_t limit;
+			~RestoreLimit() { ResourceLimits::setLimit(Resource::Disk, limit); }
+		} restore{ResourceLimits::limit(Resource::Disk)};
+		ResourceLimits::setLimit(Resource::Disk, 1);
+		std::atomic<int> running{0};
+		std::atomic<int> maxRunning{0};
+		auto job = [&running, &maxRunning]()
+		{
+			const int now = ++running;
+			int expected = maxRunning;
+			while (now > expected && !maxRunning.compare_exchange_weak(expected, now)) {}
+			std::this_thread::sleep_for(5ms);
+			--running;
+		};
+		QVector<Future<void>> futures;
+		for (int i = 0; i < 4; ++i) {
+			futures.append(async(Resource::Disk, job));
+		}
+		whenAll(futures).result();
+		QCOMPARE(maxRunning.load(), 1);
+
+		// the inner task would never get a slot if it had to wait for the outer one
+		QCOMPARE(async(Resource::Disk, [](Notifier notifier)
+		{
+			return notifier.await(async(Resource::Disk, []() { return 42; }));
+		}).result(), 42);
+		// but one that it does not await waits for its slot like everybody else
+		std::atomic<bool> innerRan{false};
+		QCOMPARE(async(Resource::Disk, [&innerRan]()
+		{
+			Future<void> inner = async(Resource::Disk, [&innerRan]() { innerRan = true; });
+			inner.start();
+			std::this_thread::sleep_for(50ms);
+			return innerRan.load();
+		}).result(), false);
+		QTRY_VERIFY(innerRan);
+
+		// raising the limit starts those that are waiting
+		std::atomic<bool> release{false};
+		std::atomic<bool> ran{false};
+		Future<void> blocking = async(Resource::Disk, [&release]()
+		{
+			while (!release) {
+				std::this_thread::sleep_for(1ms);
+			}
+		});
+		blocking.start();
+		Future<void> waiting = async(Resource::Disk, [&ran]() { ran = true; });
+		waiting.start();
+		std::this_thread::sleep_for(20ms);
+		const bool ranBeforeRaise = ran;
+		ResourceLimits::setLimit(Resource::Disk, 2);
+		waiting.result();
+		release = true;
+		blocking.result();
+		QVERIFY(!ranBeforeRaise);
+	}
+	void singleFlight()
+	{
+		SingleFlight<int> flight;
+		std::mutex mutex;
+		mutex.lock();
+		std::atomic<int> runs{0};
+		auto start = [&mutex, &runs]()
+		{
+			return async([&mutex, &runs]()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				return ++runs;
+			});
+		};
+
+		Future<int> first = flight.run("key", start);
+		Future<int> second = flight.run("key", start);
+		Future<int> other = flight.run("other", start);
+		mutex.unlock();
+		QCOMPARE(first.result(), second.result());
+		other.result();
+		QCOMPARE(runs.load(), 2);
+
+		// only in-flight operations are shared
+		QTRY_COMPARE(flight.run("key", start).result(), 3);
+	}
+	void singleFlightOnlyCancelsOnceEverybodyHas()
+	{
+		SingleFlight<int> flight;
+		std::atomic<bool> release{false};
+		std::atomic<bool> canceled{false};
+		auto start = [&release, &canceled]()
+		{
+			return async([&release, &canceled](Notifier notifier)
+			{
+				while (!release) {
+					if (notifier.isCanceled()) {
+						canceled = true;
+						throw CanceledException("canceled");
+					}
+					std::this_thread::yield();
+				}
+				return 42;
+			});
+		};
+
+		Future<int> first = flight.run("key", start);
+		Future<int> second = flight.run("key", start);
+		first.cancel();
+		std::this_thread::sleep_for(20ms);
+		QVERIFY(!canceled);
+		release = true;
+		QCOMPARE(second.result(), 42);
+		QVERIFY_EXCEPTION_THROWN(first.result(), CanceledException);
+
+		release = false;
+		Future<int> third = flight.run("other", start);
+		Future<int> fourth = flight.run("other", start);
+		third.cancel();
+		fourth.cancel();
+		QVERIFY_EXCEPTION_THROWN(fourth.result(), CanceledException);
+		QTRY_VERIFY(canceled);
+	}
+	void lockFiles()
+	{
+		QTemporaryDir dir;
+		const QString path = dir.path() + "/sub/thing.lock";
+		const std::shared_ptr<QLockFile> first = acquireLock(path, "Waiting").result();
+		QVERIFY(first->isLocked());
+
+		std::atomic<bool> acquired{false};
+		Future<std::shared_ptr<QLockFile>> second = acquireLock(path, "Waiting");
+		second.addContinuation([&acquired]() { acquired = true; });
+		second.start();
+		std::this_thread::sleep_for(200ms);
+		QVERIFY(!acquired);
+		// waiting for the lock does not keep the executor busy
+		QCOMPARE(async([]() { return 42; }).result(), 42);
+		first->unlock();
+		QVERIFY(second.result()->isLocked());
+
+		Future<std::shared_ptr<QLockFile>> third = acquireLock(path, "Waiting");
+		third.start();
+		third.cancel();
+		QVERIFY_EXCEPTION_THROWN(third.result(), CanceledException);
+	}
+	// enables tracing for the rest of the process, so keep this last
+	void tracing()
+	{
+		QTemporaryDir dir;
+		const QString filename = dir.path() + "/trace.json";
+		Trace::enable(filename);
+		QCOMPARE(async([](Notifier notifier)
+		{
+			notifier.status("outer");
+			return notifier.await(async([](Notifier inner) { inner.status("inner"); return 42; }));
+		}).result(), 42);
+		Trace::write();
+
+		QFile file(filename);
+		QVERIFY(file.open(QFile::ReadOnly));
+		const QJsonArray events = QJsonDocument::fromJson(file.readAll()).object().value("traceEvents").toArray();
+		QJsonObject outer, inner;
+		for (const QJsonValue &value : events) {
+			const QJsonObject event = value.toObject();
+			if (event.value("ph").toString() == "X" && event.value("name").toString() == "outer") {
+				outer = event;
+			} else if (event.value("ph").toString() == "X" && event.value("name").toString() == "inner") {
+				inner = event;
+			}
+		}
+		QVERIFY(!outer.isEmpty());
+		QVERIFY(!inner.isEmpty());
+		QCOMPARE(inner.value("args").toObject().value("parent"), outer.value("args").toObject().value("task"));
+	}
 };
 
 Future_Test::~Future_Test() {}
@@ -0,0 +1,448 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QFile>
+#include <QFileInfo>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "package/PackageDatabase.h"
+#include "package/PackageSource.h"
+#include "package/Package.h"
+#include "Exception.h"
+
+using namespace Ralph::ClientLib;
+
+static void writeManifest(const QDir &dir, const QString &file, const QString &name, const QString &version, const QVector<QString> &dependencies = {})
+{
+	QJsonArray deps;
+	for (const QString &dependency : dependencies) {
+		deps.append(QJsonObject({{"name", dependency.section(' ', 0, 0)}, {"version", dependency.section(' ', 1)}}));
+	}
+	QFile f(dir.absoluteFilePath(file));
+	QVERIFY(f.open(QFile::WriteOnly | QFile::Truncate));
+	f.write(QJsonDocument(QJsonObject({{"name", name}, {"version", version}, {"dependencies", deps}})).toJson());
+}
+static QVector<QString> versions(const QVector<const Package *> &packages)
+{
+	QVector<QString> out;
+	for (const Package *pkg : packages) {
+		out.append(pkg->version().toString());
+	}
+	return out;
+}
+
+// a git repo source without the git, the revision and what changed are set by the test
+class DiffedPackageSource : public GitRepoPackageSource
+{
+public:
+	QString currentRevision;
+	QVector<QString> changed; ///< Returned by changedManifests, which fails if this is empty
+
+	mutable std::mutex mutex;
+	mutable QVector<QVector<QString>> reads; ///< Arguments of all calls to manifests(paths)
+	mutable QVector<QString> changedSince; ///< Arguments of all calls to changedManifests
+
+	using GitRepoPackageSource::manifests;
+	Future<QVector<Manifest>> manifests(const QVector<QString> &paths) const override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			reads.append(paths);
+		}
+		return GitRepoPackageSource::manifests(paths);
+	}
+	Future<QString> revision() const override { return makeReadyFuture(currentRevision); }
+	Future<QVector<QString>> changedManifests(const QString &since) const override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			changedSince.append(since);
+		}
+		const QVector<QString> result = changed;
+		return async([result]()
+		{
+			if (result.isEmpty()) {
+				throw Exception("Unknown revision");
+			}
+			return result;
+		});
+	}
+};
+
+/// Registers a source named main with db, manifests go into its basePath()
+static std::unique_ptr<DiffedPackageSource> addSource(PackageDatabase *db)
+{
+	std::unique_ptr<DiffedPackageSource> src = std::make_unique<DiffedPackageSource>();
+	src->setName("main");
+	db->registerPackageSource(src.get()).result();
+	src->basePath().mkpath(src->basePath().absolutePath());
+	return src;
+}
+/// The tests below mark which database a package comes from with its first dependency
+static QString origin(const Package *pkg)
+{
+	return pkg ? pkg->dependencies().first().package() : QString();
+}
+
+class PackageDatabase_Test : public QObject
+{
+	Q_OBJECT
+public:
+	virtual ~PackageDatabase_Test();
+
+private slots:
+	void reindexOnlyReadsChangedManifests()
+	{
+		QTemporaryDir dir;
+		std::unique_ptr<PackageDatabase> db(PackageDatabase::get(dir.path()).result());
+		QVERIFY(db);
+		std::unique_ptr<DiffedPackageSource> src = std::make_unique<DiffedPackageSource>();
+		src->setName("main");
+		src->currentRevision = "r1";
+		db->registerPackageSource(src.get()).result();
+		const QDir base = src->basePath();
+		QVERIFY(base.mkpath(base.absolutePath()));
+		writeManifest(base, "bar.json", "bar", "1.0.0");
+		writeManifest(base, "foo-1.json", "foo", "1.0.0", {"bar >=1.0"});
+		writeManifest(base, "foo-2.json", "foo", "2.0.0", {"bar >=1.0"});
+
+		// nothing indexed yet, so everything is read
+		QCOMPARE(versions(db->findPackages("foo")), QVector<QString>({"1.0.0", "2.0.0"}));
+		QCOMPARE(src->reads.size(), 1);
+		QCOMPARE(src->reads.last(), QVector<QString>({"bar.json", "foo-1.json", "foo-2.json"}));
+		QVERIFY(QFile::exists(dir.path() + "/cache.dat"));
+
+		// modified, removed and added
+		writeManifest(base, "foo-2.json", "foo", "2.1.0", {"baz >=1.0"});
+		QVERIFY(base.remove("bar.json"));
+		writeManifest(base, "baz.json", "baz", "1.0.0");
+		src->currentRevision = "r2";
+		src->changed = {"foo-2.json", "bar.json", "baz.json"};
+		src->setLastUpdated();
+		db->build().result();
+
+		QCOMPARE(src->changedSince, QVector<QString>({"r1"}));
+		QCOMPARE(src->reads.size(), 2);
+		QCOMPARE(src->reads.last(), src->changed);
+		QCOMPARE(versions(db->findPackages("foo")), QVector<QString>({"1.0.0", "2.1.0"}));
+		QCOMPARE(db->findPackages("foo").last()->dependencies().first().package(), QString("baz"));
+		QVERIFY(db->findPackages("bar").isEmpty());
+		QCOMPARE(versions(db->findPackages("baz")), QVector<QString>({"1.0.0"}));
+		QCOMPARE(db->packageNames().size(), 2);
+
+		// if the source can't tell what changed (force pushed for example) everything is read again
+		writeManifest(base, "foo-1.json", "foo", "1.0.1");
+		src->currentRevision = "r3";
+		src->changed.clear();
+		src->setLastUpdated();
+		db->build().result();
+
+		QCOMPARE(src->changedSince.last(), QString("r2"));
+		QCOMPARE(src->reads.size(), 3);
+		QCOMPARE(src->reads.last(), QVector<QString>({"baz.json", "foo-1.json", "foo-2.json"}));
+		QCOMPARE(versions(db->findPackages("foo")), QVector<QString>({"1.0.1", "2.1.0"}));
+
+		// no change at all uses the index as it is
+		db->build().result();
+		QCOMPARE(src->reads.size(), 3);
+		QVERIFY(db->stats().cacheHit);
+	}
+	void pinnedPackagesSurviveRebuilds()
+	{
+		QTemporaryDir dir;
+		std::unique_ptr<PackageDatabase> db(PackageDatabase::get(dir.path()).result());
+		std::unique_ptr<DiffedPackageSource> src = std::make_unique<DiffedPackageSource>();
+		src->setName("main");
+		db->registerPackageSource(src.get()).result();
+		const QDir base = src->basePath();
+		QVERIFY(base.mkpath(base.absolutePath()));
+		writeManifest(base, "foo.json", "foo", "1.0.0", {"bar >=1.0"});
+
+		const Package *pkg = db->bestPackage("foo");
+		const PackageDatabase::Pin pin = db->pin();
+		for (int i = 0; i < 3; ++i) {
+			writeManifest(base, "foo.json", "foo", QString("1.0.%1").arg(i + 1));
+			src->setLastUpdated();
+			db->build().result();
+		}
+		QCOMPARE(db->bestPackage("foo")->version().toString(), QString("1.0.3"));
+		QCOMPARE(pkg->version().toString(), QString("1.0.0"));
+		QCOMPARE(pkg->dependencies().first().package(), QString("bar"));
+	}
+	void readersShareOneBuild()
+	{
+		QTemporaryDir dir;
+		std::unique_ptr<PackageDatabase> db(PackageDatabase::get(dir.path()).result());
+		std::unique_ptr<DiffedPackageSource> src = std::make_unique<DiffedPackageSource>();
+		src->setName("main");
+		db->registerPackageSource(src.get()).result();
+		const QDir base = src->basePath();
+		QVERIFY(base.mkpath(base.absolutePath()));
+		for (int i = 0; i < 50; ++i) {
+			writeManifest(base, QString("pkg%1.json").arg(i), QString("pkg%1").arg(i), "1.0.0");
+		}
+
+		std::vector<std::future<int>> readers;
+		for (int i = 0; i < 8; ++i) {
+			readers.push_back(std::async(std::launch::async, [&db, i]() { return db->findPackages(QString("pkg%1").arg(i)).size(); }));
+		}
+		for (std::future<int> &reader : readers) {
+			QCOMPARE(reader.get(), 1);
+		}
+		QCOMPARE(db->stats().builds, 1);
+
+		// readers running while a source is added see the packages from either before or after, never a partial build
+		std::unique_ptr<DiffedPackageSource> second = std::make_unique<DiffedPackageSource>();
+		second->setName("second");
+		second->setBasePath(QDir(dir.path()).absoluteFilePath("sources/second"));
+		QVERIFY(second->basePath().mkpath(second->basePath().absolutePath()));
+		writeManifest(second->basePath(), "pkg0.json", "pkg0", "2.0.0");
+		second->setLastUpdated();
+		readers.clear();
+		for (int i = 0; i < 8; ++i) {
+			readers.push_back(std::async(std::launch::async, [&db]() { return db->findPackages("pkg0").size(); }));
+		}
+		db->registerPackageSource(second.get()).result();
+		for (std::future<int> &reader : readers) {
+			const int found = reader.get();
+			QVERIFY(found == 1 || found == 2);
+		}
+		QCOMPARE(versions(db->findPackages("pkg0")), QVector<QString>({"1.0.0", "2.0.0"}));
+	}
+	void statsFollowBuilds()
+	{
+		QTemporaryDir dir;
+		std::unique_ptr<PackageDatabase> db(PackageDatabase::get(dir.path()).result());
+		std::unique_ptr<DiffedPackageSource> src = std::make_unique<DiffedPackageSource>();
+		src->setName("main");
+		db->registerPackageSource(src.get()).result();
+		const QDir base = src->basePath();
+		QVERIFY(base.mkpath(base.absolutePath()));
+		writeManifest(base, "bar.json", "bar", "1.0.0");
+		writeManifest(base, "foo-1.json", "foo", "1.0.0", {"bar >=1.0"});
+		writeManifest(base, "foo-2.json", "foo", "2.0.0", {"bar >=1.0"});
+		const qint64 manifestBytes = QFileInfo(base.absoluteFilePath("bar.json")).size()
+				+ QFileInfo(base.absoluteFilePath("foo-1.json")).size() + QFileInfo(base.absoluteFilePath("foo-2.json")).size();
+
+		db->build().result();
+		const PackageDatabase::Stats first = db->stats();
+		QCOMPARE(first.sources, 1);
+		QCOMPARE(first.manifests, 3);
+		QCOMPARE(first.bytesParsed, manifestBytes);
+		QCOMPARE(first.builds, 1);
+		QVERIFY(!first.cacheHit);
+		QVERIFY(first.buildTime > 0);
+		QCOMPARE(first.indexSize, QFileInfo(dir.path() + "/cache.dat").size());
+		QVERIFY(first.indexResident <= first.indexSize);
+
+		// nothing changed, so nothing is parsed again
+		db->build().result();
+		const PackageDatabase::Stats second = db->stats();
+		QCOMPARE(second.builds, 2);
+		QVERIFY(second.cacheHit);
+		QCOMPARE(second.bytesParsed, manifestBytes);
+		QCOMPARE(second.manifests, 3);
+		QVERIFY(second.buildTime >= first.buildTime);
+
+		// like the next invocation of ralph
+		std::unique_ptr<PackageDatabase> reopened(PackageDatabase::get(dir.path()).result());
+		reopened->build().result();
+		const PackageDatabase::Stats third = reopened->stats();
+		QCOMPARE(third.sources, 1);
+		QCOMPARE(third.manifests, 3);
+		QCOMPARE(third.bytesParsed, qint64(0));
+		QCOMPARE(third.builds, 1);
+		QVERIFY(third.cacheHit);
+		QCOMPARE(third.indexSize, first.indexSize);
+	}
+	void changesByOthersAreDetected()
+	{
+		QTemporaryDir dir;
+		std::unique_ptr<PackageDatabase> db(PackageDatabase::get(dir.path()).result());
+		db->build().result();
+		// what we wrote ourselves is not a change
+		QVERIFY(!db->isOutdated());
+
+		// like another ralph process adding a source
+		std::unique_ptr<PackageDatabase> other(PackageDatabase::get(dir.path()).result());
+		DiffedPackageSource *src = new DiffedPackageSource;
+		src->setName("main");
+		other->registerPackageSource(src).result();
+		QVERIFY(QDir().mkpath(src->basePath().absolutePath()));
+		writeManifest(src->basePath(), "foo.json", "foo", "1.0.0");
+		QVERIFY(db->isOutdated());
+
+		db->reload().result();
+		QVERIFY(!db->isOutdated());
+		QCOMPARE(db->sources().size(), 1);
+		QCOMPARE(versions(db->findPackages("foo")), QVector<QString>({"1.0.0"}));
+	}
+	void manifestsAreReadInOrder()
+	{
+		QTemporaryDir dir;
+		GitRepoPackageSource src;
+		src.setName("main");
+		src.setBasePath(dir.path());
+		// enough for several chunks per thread
+		QVector<QString> files;
+		for (int i = 0; i < 500; ++i) {
+			files.append(QString("pkg%1.json").arg(i, 3, 10, QChar('0')));
+			writeManifest(dir.path(), files.last(), QString("pkg%1").arg(i), "1.0.0");
+		}
+
+		const QVector<PackageSource::Manifest> manifests = src.manifests(files).result();
+		QCOMPARE(manifests.size(), files.size());
+		for (int i = 0; i < files.size(); ++i) {
+			QCOMPARE(manifests.at(i).path, files.at(i));
+			QCOMPARE(manifests.at(i).package->name(), QString("pkg%1").arg(i));
+			delete manifests.at(i).package;
+		}
+		QCOMPARE(src.parseStats().manifests, files.size());
+		QVERIFY(src.parseStats().bytes > 0);
+	}
+	void manifestErrorsAreCollected()
+	{
+		QTemporaryDir dir;
+		GitRepoPackageSource src;
+		src.setName("main");
+		src.setBasePath(dir.path());
+		for (int i = 0; i < 100; ++i) {
+			writeManifest(dir.path(), QString("pkg%1.json").arg(i), QString("pkg%1").arg(i), "1.0.0");
+		}
+		{
+			QFile broken(dir.absoluteFilePath("pkg13.json"));
+			QVERIFY(broken.open(QFile::WriteOnly | QFile::Truncate));
+			broken.write("{\"name\": \"pkg13\",");
+		}
+		{
+			QFile noVersion(dir.absoluteFilePath("pkg87.json"));
+			QVERIFY(noVersion.open(QFile::WriteOnly | QFile::Truncate));
+			noVersion.write("{\"name\": \"pkg87\"}");
+		}
+
+		// one error for all broken manifests, not just for the first one that happens to be parsed
+		try {
+			src.manifests().result();
+			QFAIL("Expected an exception");
+		} catch (Exception &e) {
+			QVERIFY2(e.cause().startsWith("Unable to read 2 manifest(s):\n"), qPrintable(e.cause()));
+			QVERIFY2(e.cause().contains("\npkg13.json: "), qPrintable(e.cause()));
+			QVERIFY2(e.cause().contains("\npkg87.json: "), qPrintable(e.cause()));
+		}
+
+		// whatever is not a top level manifest (anymore) is skipped without an error
+		const QVector<PackageSource::Manifest> manifests = src.manifests({"pkg1.json", "missing.json", "sub/pkg2.json", "pkg2.txt"}).result();
+		QCOMPARE(manifests.size(), 1);
+		QCOMPARE(manifests.first().path, QString("pkg1.json"));
+		delete manifests.first().package;
+	}
+
+	void inheritedVersionsComeInOrderOfPrecedence()
+	{
+		QTemporaryDir dir;
+		std::unique_ptr<PackageDatabase> system(PackageDatabase::get(dir.path() + "/system").result());
+		std::unique_ptr<PackageDatabase> user(PackageDatabase::get(dir.path() + "/user", {system.get()}).result());
+		std::unique_ptr<PackageDatabase> project(PackageDatabase::get(dir.path() + "/project", {user.get()}).result());
+		const std::unique_ptr<DiffedPackageSource> systemSource = addSource(system.get());
+		const std::unique_ptr<DiffedPackageSource> userSource = addSource(user.get());
+		const std::unique_ptr<DiffedPackageSource> projectSource = addSource(project.get());
+		writeManifest(systemSource->basePath(), "foo-0.json", "foo", "0.5.0", {"system >=1.0"});
+		writeManifest(systemSource->basePath(), "foo-1.json", "foo", "1.0.0", {"system >=1.0"});
+		writeManifest(userSource->basePath(), "foo-1.json", "foo", "1.0.0", {"user >=1.0"});
+		writeManifest(userSource->basePath(), "foo-2.json", "foo", "2.0.0", {"user >=1.0"});
+		writeManifest(projectSource->basePath(), "foo-1.json", "foo", "1.0.0", {"project >=1.0"});
+
+		const QVector<const Package *> foos = project->findPackages("foo");
+		QCOMPARE(versions(foos), QVector<QString>({"0.5.0", "1.0.0", "1.0.0", "1.0.0", "2.0.0"}));
+		QCOMPARE(origin(foos.at(1)), QString("project"));
+		QCOMPARE(origin(foos.at(2)), QString("user"));
+		QCOMPARE(origin(foos.at(3)), QString("system"));
+		// the first query built all of them
+		QCOMPARE(system->stats().builds, 1);
+		QCOMPARE(user->stats().builds, 1);
+		QCOMPARE(project->stats().builds, 1);
+
+		QCOMPARE(origin(project->bestPackage("foo", VersionRequirement::fromString("==1.0.0"))), QString("project"));
+		QCOMPARE(origin(project->getPackage("foo", Version::fromString("1.0.0"))), QString("project"));
+		QCOMPARE(origin(project->bestPackage("foo")), QString("user"));
+		QCOMPARE(origin(project->bestPackage("foo", VersionRequirement::fromString("<1.0.0"))), QString("system"));
+		QCOMPARE(origin(user->bestPackage("foo", VersionRequirement::fromString("==1.0.0"))), QString("user"));
+		QCOMPARE(versions(system->findPackages("foo")), QVector<QString>({"0.5.0", "1.0.0"}));
+	}
+	void inheritedRebuildsUpdateTheMergedView()
+	{
+		QTemporaryDir dir;
+		std::unique_ptr<PackageDatabase> user(PackageDatabase::get(dir.path() + "/user").result());
+		std::unique_ptr<PackageDatabase> project(PackageDatabase::get(dir.path() + "/project", {user.get()}).result());
+		const std::unique_ptr<DiffedPackageSource> userSource = addSource(user.get());
+		const std::unique_ptr<DiffedPackageSource> projectSource = addSource(project.get());
+		writeManifest(userSource->basePath(), "foo-1.json", "foo", "1.0.0", {"user >=1.0"});
+		writeManifest(projectSource->basePath(), "foo-1.json", "foo", "1.0.0", {"project >=1.0"});
+		QCOMPARE(versions(project->findPackages("foo")), QVector<QString>({"1.0.0", "1.0.0"}));
+
+		// only the user database changes, what the project memoized from it is outdated nonetheless
+		writeManifest(userSource->basePath(), "foo-2.json", "foo", "2.0.0", {"user >=1.0"});
+		userSource->setLastUpdated();
+		user->build().result();
+		QCOMPARE(versions(project->findPackages("foo")), QVector<QString>({"1.0.0", "1.0.0", "2.0.0"}));
+		QCOMPARE(origin(project->bestPackage("foo")), QString("user"));
+		QCOMPARE(project->stats().builds, 1);
+	}
+	void createLinksTheLayers()
+	{
+		QTemporaryDir dir;
+		qputenv("RALPH_SYSTEM_DATABASE", QString(dir.path() + "/system").toLocal8Bit());
+		qputenv("RALPH_USER_DATABASE", QString(dir.path() + "/user").toLocal8Bit());
+		std::unique_ptr<PackageDatabase> project(PackageDatabase::create(dir.path() + "/project").result());
+		std::unique_ptr<PackageDatabase> global(PackageDatabase::create(QString()).result());
+		qunsetenv("RALPH_SYSTEM_DATABASE");
+		qunsetenv("RALPH_USER_DATABASE");
+
+		// project -> user -> system
+		QCOMPARE(project->dir().absolutePath(), QDir(dir.path() + "/project").absolutePath());
+		QCOMPARE(project->inheritedDatabases().size(), 1);
+		std::unique_ptr<PackageDatabase> user(project->inheritedDatabases().first());
+		QCOMPARE(user->dir().absolutePath(), QDir(dir.path() + "/user").absolutePath());
+		QCOMPARE(user->inheritedDatabases().size(), 1);
+		std::unique_ptr<PackageDatabase> system(user->inheritedDatabases().first());
+		QCOMPARE(system->dir().absolutePath(), QDir(dir.path() + "/system").absolutePath());
+		QVERIFY(system->inheritedDatabases().isEmpty());
+
+		// without a project it is the user database
+		QCOMPARE(global->dir().absolutePath(), QDir(dir.path() + "/user").absolutePath());
+		QCOMPARE(global->inheritedDatabases().size(), 1);
+		std::unique_ptr<PackageDatabase> globalSystem(global->inheritedDatabases().first());
+		QCOMPARE(globalSystem->dir().absolutePath(), QDir(dir.path() + "/system").absolutePath());
+
+		// and what is in the system database is found through the project
+		const std::unique_ptr<DiffedPackageSource> systemSource = addSource(system.get());
+		writeManifest(systemSource->basePath(), "foo.json", "foo", "1.0.0", {"system >=1.0"});
+		QCOMPARE(origin(project->bestPackage("foo")), QString("system"));
+	}
+};
+PackageDatabase_Test::~PackageDatabase_Test() {}
+
+QTEST_GUILESS_MAIN(PackageDatabase_Test)
+
+#include "PackageDatabase_Test.moc"
@@ -0,0 +1,280 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QTest>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <memory>
+
+#include "package/PackageIndex.h"
+#include "package/Package.h"
+
+using namespace Ralph::ClientLib;
+
+static PackageIndex::Record record(const QString &source, const QString &path, const QString &name, const QString &version,
+								   const QVector<QString> &dependencies = {})
+{
+	Package pkg;
+	pkg.setName(name);
+	pkg.setVersion(Version::fromString(version));
+	QVector<PackageDependency> deps;
+	for (const QString &dependency : dependencies) {
+		PackageDependency dep;
+		dep.setPackage(dependency.section(' ', 0, 0));
+		dep.setVersion(VersionRequirement::fromString(dependency.section(' ', 1)));
+		deps.append(dep);
+	}
+	pkg.setDependencies(deps);
+	return PackageIndex::Record::fromPackage(source, path, &pkg);
+}
+
+static void writeSample(const QString &filename)
+{
+	PackageIndex::write(filename, {{"main", QDateTime::fromMSecsSinceEpoch(1480000000000)}}, {{"main", "abc123"}}, {
+							record("main", "foo/1.json", "foo", "1.0.0", {"bar >=1.0"}),
+							record("main", "foo/2.json", "foo", "2.0.0", {"bar >=2.0"}),
+							record("main", "bar/1.json", "bar", "1.0.0"),
+							record("main", "foobar/1.json", "foobar", "0.1.0")
+						});
+}
+static QByteArray readAll(const QString &filename)
+{
+	QFile file(filename);
+	file.open(QFile::ReadOnly);
+	return file.readAll();
+}
+static void writeAll(const QString &filename, const QByteArray &data)
+{
+	QFile file(filename);
+	file.open(QFile::WriteOnly | QFile::Truncate);
+	file.write(data);
+}
+static void patch32(QByteArray &data, const int offset, const quint32 value)
+{
+	qToLittleEndian(value, reinterpret_cast<uchar *>(data.data() + offset));
+}
+static QVector<QString> describe(const QVector<NameSearch::Match> &matches)
+{
+	static const char *kinds[] = {"exact", "prefix", "substring", "fuzzy"};
+	QVector<QString> out;
+	for (const NameSearch::Match &match : matches) {
+		out.append(QString("%1:%2").arg(kinds[match.kind], match.name));
+	}
+	return out;
+}
+// touches every byte an index refers to, false if any of it is out of bounds or broken
+static bool readsEverything(const PackageIndex &index)
+{
+	try {
+		for (const QString &name : index.names()) {
+			for (const Package *pkg : index.find(name)) {
+				pkg->ensureLoaded();
+			}
+			index.search(name, 0);
+		}
+		index.records("main");
+		return true;
+	} catch (Exception &) {
+		return false;
+	}
+}
+
+class PackageIndex_Test : public QObject
+{
+	Q_OBJECT
+public:
+	virtual ~PackageIndex_Test();
+
+private slots:
+	void roundTrip()
+	{
+		QTemporaryDir dir;
+		const QString filename = dir.path() + "/cache.dat";
+		const QDateTime updated = QDateTime::fromMSecsSinceEpoch(1480000000000);
+		PackageIndex::write(filename, {{"main", updated}, {"other", updated.addDays(1)}}, {{"main", "abc123"}, {"other", QString()}}, {
+								record("main", "foo/2.json", "Foo", "2.0.0", {"bar >=1.0"}),
+								record("main", "bar/1.json", "bar", "1.0.0"),
+								record("other", "foo.json", "foo", "1.0.0"),
+								record("main", "foo/1.json", "foo", "1.5.0")
+							});
+
+		PackageIndex index;
+		QVERIFY(index.open(filename));
+		QVERIFY(index.isOpen());
+		QCOMPARE(index.sourceTimestamps().value("main"), updated);
+		QCOMPARE(index.sourceTimestamps().value("other"), updated.addDays(1));
+		QCOMPARE(index.sourceRevisions().value("main"), QString("abc123"));
+		QVERIFY(index.sourceRevisions().value("other").isEmpty());
+		QCOMPARE(index.recordCount(), 4u);
+		QCOMPARE(index.names(), QVector<QString>({"bar", "foo"}));
+
+		// sorted by version, no matter in which order they were written
+		const QVector<const Package *> foos = index.find("foo");
+		QCOMPARE(foos.size(), 3);
+		QCOMPARE(foos.at(0)->version().toString(), QString("1.0.0"));
+		QCOMPARE(foos.at(1)->version().toString(), QString("1.5.0"));
+		QCOMPARE(foos.at(2)->version().toString(), QString("2.0.0"));
+		QCOMPARE(foos.at(2)->name(), QString("Foo"));
+		QCOMPARE(foos.at(2)->dependencies().size(), 1);
+		QCOMPARE(foos.at(2)->dependencies().first().package(), QString("bar"));
+		QCOMPARE(foos.at(2)->dependencies().first().version().toString(), QString(">=1.0"));
+
+		QCOMPARE(index.get("foo", Version::fromString("1.5.0")), foos.at(1));
+		QCOMPARE(index.get("foo", Version::fromString("3.0.0")), static_cast<const Package *>(nullptr));
+		QVERIFY(index.find("baz").isEmpty());
+
+		// what a rebuild copies over for unchanged sources
+		const QVector<PackageIndex::Record> kept = index.records("main");
+		QCOMPARE(kept.size(), 3);
+		for (const PackageIndex::Record &rec : kept) {
+			QCOMPARE(rec.source, QString("main"));
+			const std::unique_ptr<Package> pkg(rec.package());
+			QCOMPARE(pkg->name().toLower(), rec.name);
+			QCOMPARE(pkg->version().toString(), rec.version);
+		}
+		QCOMPARE(index.records("other").size(), 1);
+		QCOMPARE(index.records("other").first().path, QString("foo.json"));
+	}
+	void missingFileDoesNotOpen()
+	{
+		QTemporaryDir dir;
+		PackageIndex index;
+		QVERIFY(!index.open(dir.path() + "/cache.dat"));
+		QVERIFY(!index.isOpen());
+		QVERIFY(index.names().isEmpty());
+	}
+	void packagesAreDecodedLazily()
+	{
+		QTemporaryDir dir;
+		const QString filename = dir.path() + "/cache.dat";
+		PackageIndex::Record broken = record("main", "broken.json", "broken", "1.0.0", {"foo >=1.0"});
+		broken.data.chop(4);
+		PackageIndex::write(filename, {}, {}, {broken, record("main", "foo.json", "foo", "1.0.0", {"bar >=1.0"})});
+
+		PackageIndex index;
+		QVERIFY(index.open(filename));
+
+		// name and version are all that is read up front, the rest only fails once it is needed
+		const Package *lazy = index.find("broken").first();
+		QCOMPARE(lazy->name(), QString("broken"));
+		QCOMPARE(lazy->version().toString(), QString("1.0.0"));
+		QVERIFY_EXCEPTION_THROWN(lazy->dependencies(), Exception);
+
+		// decoded once, and still usable after the mapping is gone
+		const Package *foo = index.find("foo").first();
+		QCOMPARE(index.find("foo").first(), foo);
+		QCOMPARE(index.get("foo", Version::fromString("1.0.0")), foo);
+		index.close();
+		QCOMPARE(foo->dependencies().size(), 1);
+		QCOMPARE(foo->dependencies().first().package(), QString("bar"));
+	}
+	void searchRanking_data()
+	{
+		QTest::addColumn<QString>("query");
+		QTest::addColumn<int>("limit");
+		QTest::addColumn<QVector<QString>>("expected");
+
+		// shorter names first within a kind, then by name
+		QTest::newRow("no trigrams") << "qt" << 0 << QVector<QString>({"exact:qt", "prefix:qtbase", "prefix:qtwebengine", "substring:libqt"});
+		QTest::newRow("limited") << "qt" << 2 << QVector<QString>({"exact:qt", "prefix:qtbase"});
+		QTest::newRow("case insensitive") << "QtBase" << 0 << QVector<QString>({"exact:qtbase"});
+		QTest::newRow("prefix") << "boost" << 0 << QVector<QString>({"exact:boost", "prefix:boost-python"});
+		QTest::newRow("substring") << "webengin" << 0 << QVector<QString>({"substring:qtwebengine"});
+		QTest::newRow("typo") << "qtbasd" << 0 << QVector<QString>({"fuzzy:qtbase"});
+		QTest::newRow("fuzzy after proper matches") << "pyth" << 0 << QVector<QString>({"substring:boost-python", "fuzzy:pytest"});
+		QTest::newRow("nothing") << "xyz" << 0 << QVector<QString>();
+		QTest::newRow("everything") << "" << 3 << QVector<QString>({"prefix:qt", "prefix:cute", "prefix:boost"});
+	}
+	void searchRanking()
+	{
+		QFETCH(QString, query);
+		QFETCH(int, limit);
+		QFETCH(QVector<QString>, expected);
+
+		const QVector<QString> names = {"qt", "qtbase", "libqt", "quazip", "qtwebengine", "cute", "boost", "boost-python", "pytest"};
+		QTemporaryDir dir;
+		QVector<PackageIndex::Record> records;
+		for (const QString &name : names) {
+			records.append(record("main", name + ".json", name, "1.0.0"));
+		}
+		PackageIndex::write(dir.path() + "/cache.dat", {}, {}, records);
+		PackageIndex index;
+		QVERIFY(index.open(dir.path() + "/cache.dat"));
+
+		// both have to agree, the database uses one or the other depending on whether it could write the index
+		QCOMPARE(describe(index.search(query, limit)), expected);
+		QCOMPARE(describe(InMemoryNameSearch(names).search(query, limit)), expected);
+	}
+	void truncatedIndexIsRejected()
+	{
+		QTemporaryDir dir;
+		const QString filename = dir.path() + "/cache.dat";
+		writeSample(filename);
+		const QByteArray data = readAll(filename);
+		{
+			PackageIndex index;
+			QVERIFY(index.open(filename));
+			QVERIFY(readsEverything(index));
+		}
+
+		// either open() notices, or the first access to what got cut off throws, but nothing is read past the end
+		for (int size = 0; size < data.size(); ++size) {
+			writeAll(filename, data.left(size));
+			PackageIndex index;
+			QVERIFY2(!index.open(filename) || !readsEverything(index), qPrintable(QString("truncated to %1 bytes").arg(size)));
+		}
+	}
+	void corruptIndexIsRejected()
+	{
+		QTemporaryDir dir;
+		writeSample(dir.path() + "/cache.dat");
+		const QByteArray original = readAll(dir.path() + "/cache.dat");
+		const int recordsOffset = int(qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(original.constData() + 28)));
+		// a copy of the sample with the 32 bit value at offset replaced, every one in a file of its own
+		int copies = 0;
+		auto corrupted = [&](const int offset, const quint32 value)
+		{
+			QByteArray data = original;
+			patch32(data, offset, value);
+			const QString filename = dir.path() + QString("/corrupt%1.dat").arg(++copies);
+			writeAll(filename, data);
+			return filename;
+		};
+
+		QVERIFY(!PackageIndex().open(corrupted(0, 0xdeadbeef))); // magic
+		QVERIFY(!PackageIndex().open(corrupted(4, 3))); // format version
+		QVERIFY(!PackageIndex().open(corrupted(8, 0xfffffff0))); // offset of the source timestamps
+		QVERIFY(!PackageIndex().open(corrupted(16, 0x7fffffff))); // name count
+		QVERIFY(!PackageIndex().open(corrupted(28, quint32(original.size()) - 8))); // records offset
+
+		// record entries are only checked when they are used, the first one is bar 1.0.0
+		{
+			PackageIndex index;
+			QVERIFY(index.open(corrupted(recordsOffset + 8, 0xffffff00))); // data offset
+			QVERIFY_EXCEPTION_THROWN(index.find("bar"), PackageIndexException);
+			QCOMPARE(index.find("foo").size(), 2);
+		}
+		{
+			PackageIndex index;
+			QVERIFY(index.open(corrupted(recordsOffset + 12, 0))); // data size, leaving nothing to read a package from
+			QVERIFY_EXCEPTION_THROWN(index.find("bar"), PackageIndexException);
+		}
+	}
+};
+PackageIndex_Test::~PackageIndex_Test() {}
+
+QTEST_GUILESS_MAIN(PackageIndex_Test)
+
+#include "PackageIndex_Test.moc"
@@ -0,0 +1,198 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QTest>
+#include <QSet>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "package/PackageInstaller.h"
+#include "package/Package.h"
+#include "Exception.h"
+
+using namespace Ralph::ClientLib;
+
+// stands in for PackageGroup::install, records what was started when
+struct Installs
+{
+	std::mutex mutex;
+	QVector<QString> started;
+	int running = 0;
+	int maxRunning = 0;
+	QSet<QString> failing;
+
+	PackageInstaller::InstallFunction function(const std::shared_ptr<Installs> &self)
+	{
+		return [self](const Package *pkg, const PackageConfiguration &)
+		{
+			const QString name = pkg->name();
+			{
+				std::lock_guard<std::mutex> lock(self->mutex);
+				self->started.append(name);
+				self->maxRunning = std::max(self->maxRunning, ++self->running);
+			}
+			return async([self, name]()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				std::lock_guard<std::mutex> lock(self->mutex);
+				--self->running;
+				if (self->failing.contains(name)) {
+					throw Exception("%1 is broken" % name);
+				}
+			});
+		};
+	}
+};
+
+class PackageInstaller_Test : public QObject
+{
+	Q_OBJECT
+public:
+	virtual ~PackageInstaller_Test();
+
+private:
+	std::vector<std::unique_ptr<Package>> m_packages;
+	DependencyResolver::Resolution m_resolution;
+	std::shared_ptr<Installs> m_installs;
+
+	/// Adds name to the resolution, after the given dependencies
+	const Package *add(const QString &name, const QVector<const Package *> &dependencies = {})
+	{
+		m_packages.push_back(std::make_unique<Package>());
+		m_packages.back()->setName(name);
+		m_packages.back()->setVersion(Version::fromString("1.0.0"));
+		m_resolution.packages.append(m_packages.back().get());
+		m_resolution.dependencies.insert(m_packages.back().get(), dependencies);
+		return m_packages.back().get();
+	}
+	PackageInstaller makeInstaller(const int maxConcurrent)
+	{
+		PackageInstaller installer{PackageGroup(), PackageConfiguration()};
+		installer.setMaxConcurrent(maxConcurrent);
+		installer.setInstallFunction(m_installs->function(m_installs));
+		return installer;
+	}
+	static QString failure(Future<void> future)
+	{
+		try {
+			future.result();
+		} catch (Exception &e) {
+			return e.cause();
+		}
+		return QString();
+	}
+
+private slots:
+	void init()
+	{
+		m_packages.clear();
+		m_resolution = DependencyResolver::Resolution();
+		m_installs = std::make_shared<Installs>();
+	}
+
+	void dependenciesFirst()
+	{
+		const Package *a = add("a");
+		const Package *b = add("b", {a});
+		const Package *c = add("c", {b});
+		const Package *d = add("d");
+		// not part of the resolution, so expected to be installed already
+		Package installed;
+		installed.setName("installed");
+		add("e", {&installed, a});
+
+		PackageInstaller installer = makeInstaller(4);
+		installer.install(m_resolution).result();
+
+		QCOMPARE(m_installs->started.size(), 5);
+		QVERIFY(m_installs->started.indexOf("a") < m_installs->started.indexOf("b"));
+		QVERIFY(m_installs->started.indexOf("b") < m_installs->started.indexOf("c"));
+		QVERIFY(m_installs->started.indexOf("a") < m_installs->started.indexOf("e"));
+		for (const Package *pkg : {a, b, c, d}) {
+			QCOMPARE(failure(installer.package(pkg)), QString());
+		}
+		QCOMPARE(m_installs->running, 0);
+	}
+	void failuresAbandonTheRest()
+	{
+		const Package *a = add("a");
+		const Package *b = add("b", {a});
+		const Package *c = add("c", {b});
+		const Package *d = add("d");
+		m_installs->failing.insert("a");
+
+		// a has the longest chain, so it goes first and nothing else gets to start
+		PackageInstaller installer = makeInstaller(1);
+		QCOMPARE(failure(installer.install(m_resolution)), QString("a is broken"));
+
+		QCOMPARE(m_installs->started, QVector<QString>({"a"}));
+		QCOMPARE(failure(installer.package(a)), QString("a is broken"));
+		QCOMPARE(failure(installer.package(b)), QString("b was not installed because a failed"));
+		QCOMPARE(failure(installer.package(c)), QString("c was not installed because a failed"));
+		QCOMPARE(failure(installer.package(d)), QString("d was not installed because a failed"));
+	}
+	void maxConcurrent()
+	{
+		for (int i = 0; i < 8; ++i) {
+			add(QString("pkg%1").arg(i));
+		}
+
+		PackageInstaller installer = makeInstaller(2);
+		installer.install(m_resolution).result();
+		QCOMPARE(m_installs->started.size(), 8);
+		QVERIFY(m_installs->maxRunning <= 2);
+	}
+	void longestChainFirst()
+	{
+		add("x");
+		add("y");
+		const Package *a = add("a");
+		const Package *b = add("b", {a});
+		add("c", {b});
+
+		PackageInstaller installer = makeInstaller(1);
+		installer.install(m_resolution).result();
+		QCOMPARE(m_installs->started.size(), 5);
+		QCOMPARE(m_installs->started.mid(0, 2), QVector<QString>({"a", "b"}));
+		QCOMPARE(m_installs->maxRunning, 1);
+	}
+	void unknownPackages()
+	{
+		const Package *a = add("a");
+		Package other;
+		other.setName("other");
+
+		PackageInstaller installer = makeInstaller(1);
+		// nothing installed yet
+		QCOMPARE(failure(installer.package(a)), QString("a is not part of this installation"));
+		installer.install(m_resolution).result();
+		QCOMPARE(failure(installer.package(a)), QString());
+		QCOMPARE(failure(installer.package(&other)), QString("other is not part of this installation"));
+
+		// nothing to do at all
+		m_resolution = DependencyResolver::Resolution();
+		installer.install(m_resolution).result();
+		QCOMPARE(m_installs->started, QVector<QString>({"a"}));
+	}
+};
+PackageInstaller_Test::~PackageInstaller_Test() {}
+
+QTEST_GUILESS_MAIN(PackageInstaller_Test)
+
+#include "PackageInstaller_Test.moc"
@@ -0,0 +1,65 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QTest>
+
+#include "future/Future.h"
+#include "task/Task.h"
+
+using namespace Ralph::ClientLib;
+
+namespace {
+// what async() used to do: a separately allocated task that keeps itself alive through its future
+class SeparateTask : public Task<int>
+{
+public:
+	explicit SeparateTask() : Task<int>(std::launch::async) {}
+	int run() override { return 42; }
+};
+}
+
+class Task_Benchmark : public QObject
+{
+	Q_OBJECT
+public:
+	virtual ~Task_Benchmark();
+
+private slots:
+	void separateAllocations()
+	{
+		QBENCHMARK {
+			std::shared_ptr<SeparateTask> task = std::make_shared<SeparateTask>();
+			QCOMPARE(task->start().result(), 42);
+		}
+	}
+	void taskFrame()
+	{
+		QBENCHMARK {
+			QCOMPARE(async([]() { return 42; }).result(), 42);
+		}
+	}
+	void deferredTaskFrame()
+	{
+		QBENCHMARK {
+			QCOMPARE(async(std::launch::deferred, []() { return 42; }).result(), 42);
+		}
+	}
+};
+
+Task_Benchmark::~Task_Benchmark() {}
+
+QTEST_GUILESS_MAIN(Task_Benchmark)
+
+#include "Task_Benchmark.moc"
@@ -0,0 +1,100 @@
+/* Copyright 2016 Jan Dalheimer <jan@dalheimer.de>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <QTest>
+#include <algorithm>
+
+#include "Version.h"
+
+using namespace Ralph::ClientLib;
+
+class Version_Test : public QObject
+{
+	Q_OBJECT
+public:
+	virtual ~Version_Test();
+
+private slots:
+	void ordering_data()
+	{
+		QTest::addColumn<QString>("lower");
+		QTest::addColumn<QString>("higher");
+
+		QTest::newRow("integers") << "1.2.3" << "1.10.0";
+		QTest::newRow("more sections") << "1.0" << "1.0.1";
+		QTest::newRow("adjacent strings") << "1.0-alpha" << "1.0-beta";
+		// used to be neither less, greater nor equal, since the difference was not exactly 1
+		QTest::newRow("distant strings") << "1.0-alpha" << "1.0-rc";
+		QTest::newRow("longer string") << "1.0-rc" << "1.0-rc2";
+		// used to overflow the char it was stored in, and come out the wrong way around
+		QTest::newRow("non-ascii") << "1.0-a" << QString::fromUtf8("1.0-ä");
+		QTest::newRow("far apart") << QString::fromUtf8("1.0-Ā") << QString::fromUtf8("1.0-一");
+	}
+	void ordering()
+	{
+		QFETCH(QString, lower);
+		QFETCH(QString, higher);
+		const Version a = Version::fromString(lower);
+		const Version b = Version::fromString(higher);
+
+		QVERIFY(a < b);
+		QVERIFY(a <= b);
+		QVERIFY(!(a > b));
+		QVERIFY(!(a >= b));
+		QVERIFY(a != b);
+		QVERIFY(!(a == b));
+
+		QVERIFY(b > a);
+		QVERIFY(b >= a);
+		QVERIFY(!(b < a));
+		QVERIFY(!(b <= a));
+	}
+	void equality()
+	{
+		QVERIFY(Version::fromString("1.0") == Version::fromString("1.0.0"));
+		QVERIFY(Version::fromString("1.0-beta") == Version::fromString("1.0-beta"));
+		QVERIFY(!(Version::fromString("1.0") < Version::fromString("1.0.0")));
+		QVERIFY(!(Version::fromString("1.0.0") < Version::fromString("1.0")));
+	}
+	void strictWeakOrdering()
+	{
+		// what the package index and PackageDatabase binary search rely on
+		QVector<Version> versions;
+		for (const QString &str : {"1.0", "1.0.0", "0.9", "1.0-alpha", "1.0-rc", "1.0-beta", "1.0-rc.1", "2.0-z", "2.0-a", "10", "1.0-ä", "1.0-b"}) {
+			versions.append(Version::fromString(str));
+		}
+		for (const Version &a : versions) {
+			QVERIFY(!(a < a));
+			for (const Version &b : versions) {
+				QVERIFY(!(a < b && b < a));
+				QCOMPARE(a == b, !(a < b) && !(b < a));
+				for (const Version &c : versions) {
+					if (a < b && b < c) {
+						QVERIFY(a < c);
+					}
+				}
+			}
+		}
+		std::sort(versions.begin(), versions.end());
+		QVERIFY(std::is_sorted(versions.cbegin(), versions.cend()));
+		QCOMPARE(versions.first().toString(), QString("0.9"));
+		QCOMPARE(versions.last().toString(), QString("10"));
+	}
+};
+Version_Test::~Version_Test() {}
+
+QTEST_GUILESS_MAIN(Version_Test)
+
+#include "Version_Test.moc"
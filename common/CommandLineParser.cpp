@@ -81,14 +81,14 @@ int Parser::process(const QStringList &arguments)
 		}
 		return 0;
 	} catch (BuildException &e) {
-		std::cerr << e.what() << '\n'
+		Term::err() << e.what() << '\n'
 				  << "This is a logic error in the program. Please report it to the developer.\n";
 		return -1;
 	} catch (CommandLineException &e) {
-		std::cerr << Term::fg(Term::Red, e.what()) << "\n\n";
+		Term::err() << Term::fg(Term::Red, e.what()) << "\n\n";
 		printHelp(e.commandChain());
 	} catch (Exception &e) {
-		std::cerr << Term::fg(Term::Red, e.what()) << '\n';
+		Term::err() << Term::fg(Term::Red, e.what()) << '\n';
 		return -1;
 	}
 }
@@ -124,7 +124,7 @@ Parser &Parser::addHelpOption()
 
 void Parser::printVersion()
 {
-	std::cout << name() << " - " << version() << '\n';
+	Term::out() << name() << " - " << version() << '\n';
 	std::exit(0);
 }
 
@@ -156,15 +156,15 @@ static void printUsageFor(const QStringList &parents, const bool hasOptions, con
 {
 	QVector<QString> posArgs = positionals + formatPositionalArguments(command.arguments());
 	if (!parents.isEmpty()) {
-		std::cout << "    " << parents.join(' ');
+		Term::out() << "    " << parents.join(' ');
 		if (hasOptions) {
-			std::cout << " [OPTIONS]";
+			Term::out() << " [OPTIONS]";
 		}
 
 		if (!posArgs.isEmpty()) {
-			std::cout << ' ' << posArgs.toList().join(' ');
+			Term::out() << ' ' << posArgs.toList().join(' ');
 		}
-		std::cout << '\n';
+		Term::out() << '\n';
 	}
 
 	for (const Command &sub : Functional::collection(command.subcommands().values()).sort(&compareCommands).get()) {
@@ -179,7 +179,7 @@ static void printSubcommandsTable(const QVector<Command> &commands, const int ma
 			.filter([](const Command &command) { return !command.isHidden(); })
 			.sort(&compareCommands)
 			.map([](const Command &command) { return QVector<QString>({command.name(), "-", command.summary()}); });
-	std::cout << "    " << Term::table(rows, {10, 1, 10}, maxWidth, 4) << '\n';
+	Term::out() << "    " << Term::table(rows, {10, 1, 10}, maxWidth, 4) << '\n';
 }
 static void printOptionsTable(const QVector<Option> &options, const int maxWidth)
 {
@@ -214,7 +214,7 @@ static void printOptionsTable(const QVector<Option> &options, const int maxWidth
 
 		return QVector<QString>({syntax.join(", "), help.join('\n')});
 	});
-	std::cout << "    " << Term::table(rows, {1, 1}, maxWidth, 4) << '\n';
+	Term::out() << "    " << Term::table(rows, {1, 1}, maxWidth, 4) << '\n';
 }
 static void printArgumentsTable(const QVector<PositionalArgument> &arguments, const int maxWidth)
 {
@@ -223,7 +223,7 @@ static void printArgumentsTable(const QVector<PositionalArgument> &arguments, co
 		const QString syntax = formatPositionalArgument(argument);
 		return QVector<QString>({syntax, argument.description()});
 	});
-	std::cout << "    " << Term::table(rows, {1, 1}, maxWidth, 4) << '\n';
+	Term::out() << "    " << Term::table(rows, {1, 1}, maxWidth, 4) << '\n';
 }
 void Parser::printHelp(const QVector<QString> &commands)
 {
@@ -241,31 +241,31 @@ void Parser::printHelp(const QVector<QString> &commands)
 
 	using namespace Term;
 
-	std::cout << name() << ' ' << version() << '\n'
+	Term::out() << name() << ' ' << version() << '\n'
 			  << '\n'
 			  << style(Bold, "Usage:") << '\n';
 
 	printUsageFor(chain.toList(), !options.isEmpty(), {}, command, maxWidth);
 
 	if (!command.subcommands().isEmpty()) {
-		std::cout << '\n'
+		Term::out() << '\n'
 				  << style(Bold, "Subcommands:") << '\n';
 		printSubcommandsTable(command.subcommands().values().toVector(), maxWidth);
 	}
 	if (!options.isEmpty()) {
-		std::cout << '\n'
+		Term::out() << '\n'
 				  << style(Bold, "Options:") << '\n';
 		printOptionsTable(options, maxWidth);
 	}
 	if (!positionals.isEmpty()) {
-		std::cout << '\n'
+		Term::out() << '\n'
 				  << style(Bold, "Arguments:") << '\n';
 		printArgumentsTable(positionals, maxWidth);
 	}
 	if (!command.description().isEmpty()) {
-		std::cout << '\n'
+		Term::out() << '\n'
 				  << style(Bold, "Description:") << '\n';
-		std::cout << "    " << wrap(command.description(), maxWidth, 4) << '\n';
+		Term::out() << "    " << wrap(command.description(), maxWidth, 4) << '\n';
 	}
 
 	std::exit(0);
@@ -396,15 +396,15 @@ Result Parser::parse(const QStringList &arguments) const
 	return Result(result.options, result.arguments, result.commandChain, options, positionals);
 }
 
-void Parser::handle(const Result &result) const
+Result Parser::check(const QStringList &arguments) const
 {
-	for (const QString &option : result.options().keys()) {
-		const Option &opt = result.possibleOptions().value(option);
-		if (opt.isEarlyExit()) {
-			opt.call(result);
-		}
-	}
+	const Result result = parse(arguments);
+	validate(result);
+	return result;
+}
 
+void Parser::validate(const Result &result) const
+{
 	for (const PositionalArgument &arg : result.possiblePositionals()) {
 		if ((!result.hasArgument(arg.name()) || result.argument(arg.name()).isEmpty()) && !arg.isOptional()) {
 			throw MissingPositionalArgumentException(QString("Missing required positional argument '%1'").arg(arg.name()), result.commandChain());
@@ -422,6 +422,21 @@ void Parser::handle(const Result &result) const
 												  result.commandChain());
 			}
 		}
+	}
+}
+void Parser::handle(const Result &result) const
+{
+	for (const QString &option : result.options().keys()) {
+		const Option &opt = result.possibleOptions().value(option);
+		if (opt.isEarlyExit()) {
+			opt.call(result);
+		}
+	}
+
+	validate(result);
+
+	for (const QString &option : result.options().keys()) {
+		const Option &opt = result.possibleOptions().value(option);
 		if (!opt.isEarlyExit()) {
 			opt.call(result);
 		}
@@ -276,6 +276,8 @@ public:
 	int process(int argc, char **argv);
 	int process(const QCoreApplication &app);
 	int process(const QStringList &arguments);
+	/// Parses and validates arguments like process(), but does not run anything. Throws an Exception if they are invalid.
+	Result check(const QStringList &arguments) const;
 
 	QString version() const { return m_version; }
 	Parser &setVersion(const QString &version) { m_version = version; return *this; }
@@ -294,6 +296,7 @@ private:
 	QString m_version;
 
 	Result parse(const QStringList &arguments) const;
+	void validate(const Result &result) const;
 	void handle(const Result &result) const;
 };
 
@@ -226,8 +226,19 @@ QString restore()
 	return "\033[u";
 #endif
 }
+QString clearLine()
+{
+	if (!isTty()) {
+		return QString();
+	}
+#ifdef Q_OS_WIN
+	return "";
+#else
+	return "\033[2K\r";
+#endif
+}
 
-bool isTty()
+static bool isStdoutTty()
 {
 #ifdef Q_OS_WIN
 	return ::_isatty(_fileno(stdout));
@@ -236,8 +247,13 @@ bool isTty()
 #endif
 }
 
-int currentWidth()
+Output::Output(std::ostream &out, std::ostream &err, const bool isTty, const int width)
+	: m_out(out), m_err(err), m_isTty(isTty), m_width(width) {}
+int Output::width() const
 {
+	if (m_width != 0) {
+		return m_width;
+	}
 #ifdef Q_OS_UNIX
 	struct winsize w;
 	ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
@@ -247,6 +263,41 @@ int currentWidth()
 #endif
 }
 
+static thread_local const Output *t_currentOutput = nullptr;
+const Output &Output::current()
+{
+	static const Output process(std::cout, std::cerr, isStdoutTty());
+	return t_currentOutput ? *t_currentOutput : process;
+}
+Output::Scope::Scope(const Output &output)
+	: m_previous(t_currentOutput)
+{
+	t_currentOutput = &output;
+}
+Output::Scope::~Scope()
+{
+	t_currentOutput = m_previous;
+}
+
+std::ostream &out()
+{
+	return Output::current().out();
+}
+std::ostream &err()
+{
+	return Output::current().err();
+}
+
+bool isTty()
+{
+	return Output::current().isTty();
+}
+
+int currentWidth()
+{
+	return Output::current().width();
+}
+
 QString wrap(const QString &text, const int maxWidth, const int indent)
 {
 	static QRegularExpression breakExpression("[^a-zA-Z]");
@@ -362,7 +413,7 @@ QString readPassword()
 	std::string str;
 	detail::setStdinEcho(false);
 	std::getline(std::cin, str);
-	std::cout << '\n';
+	out() << '\n';
 	detail::setStdinEcho(true);
 	return QString::fromStdString(str);
 }
@@ -46,12 +46,58 @@ enum MoveType
 	LineUp
 };
 
+/**
+ * Where commands write to, and what they write to.
+ *
+ * That is the stdout and stderr of the process, unless a command runs for another process (see
+ * ralph daemon), in which case its output is collected separately and all terminal handling
+ * follows the terminal of the other process. All functions in here use the current output of
+ * the calling thread, see Scope.
+ */
+class Output
+{
+public:
+	/// width is the number of columns of the terminal, 0 to ask the terminal of this process
+	explicit Output(std::ostream &out, std::ostream &err, const bool isTty, const int width = 0);
+
+	std::ostream &out() const { return m_out; }
+	std::ostream &err() const { return m_err; }
+	bool isTty() const { return m_isTty; }
+	int width() const;
+
+	/// The output of the calling thread
+	static const Output &current();
+
+	/// Makes output the current one of the calling thread for as long as it exists, for example for callbacks from other threads
+	class Scope
+	{
+	public:
+		explicit Scope(const Output &output);
+		~Scope();
+
+	private:
+		const Output *m_previous;
+	};
+
+private:
+	std::ostream &m_out;
+	std::ostream &m_err;
+	const bool m_isTty;
+	const int m_width;
+};
+/// Output::current().out()
+std::ostream &out();
+/// Output::current().err()
+std::ostream &err();
+
 QString wrap(const QString &text, const int maxWidth, const int indent = 0);
 QString table(const QVector<QVector<QString>> &rows, const QVector<int> &columnSizeRatios, const int maxWidth, const int indent = 0);
 
 QString move(const MoveType type, const int n = 1);
 QString save();
 QString restore();
+/// Erases the line the cursor is on
+QString clearLine();
 QString style(const Style style, const QString &in = QString());
 QString fg(const Color color, const QString &in = QString());
 QString bg(const Color color, const QString &in = QString());
@@ -48,7 +48,7 @@ void cmakePath()
 			<< QDir::current().absoluteFilePath("cmake");
 	for (const QDir &dir : candidates) {
 		if (dir.exists("RalphFunctions.cmake") && dir.exists("RalphHelpers.cmake")) {
-			std::cout << dir.absolutePath();
+			Common::Term::out() << dir.absolutePath();
 			return;
 		}
 	}